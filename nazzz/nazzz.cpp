@@ -1,7 +1,21 @@
-#include <GL/glut.h>
+#include <GL/glew.h>
+#include <GL/freeglut.h>
 #include <cmath>
+#include <cstddef>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <atomic>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <cstring>
+#include <cctype>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
 #include <algorithm>
 #include <iostream>
 
@@ -9,6 +23,10 @@
 const int WINDOW_WIDTH = 800;
 const int WINDOW_HEIGHT = 600;
 const float PI = 3.1415926535f;
+const int NUM_TREES = 21;
+const int NUM_CLOUDS = 6;
+const int NUM_MOUNTAINS = 4;
+const int NUM_WINDMILLS = 6;
 
 // --- Global Animation & Interaction Variables ---
 float windmillAngle = 0.0f;
@@ -22,68 +40,3321 @@ float rotY = 0.0f;
 float lastX = 0.0f;
 float lastY = 0.0f;
 bool isDragging = false;
+int clickX = 0, clickY = 0; // Where the left button went down
 float zoom = -90.0f;
 
+// Camera matrices mirrored on the CPU (column-major, same layout as OpenGL)
+float projectionMatrix[16];
+float viewMatrix[16];
+float viewProjMatrix[16];
+int viewportWidth = WINDOW_WIDTH;
+int viewportHeight = WINDOW_HEIGHT;
+bool coreProfile = false; // Set for the shader renderer
+
 // Day/Night Cycle Variables
 float timeOfDay = 45.0f; // 0 to 360 degrees. 90=Sunset, 270=Sunrise
 // Colors
 float skyColor[3] = { 0.85f, 0.95f, 0.98f }; // Current Sky Color
 
-// --- Helper Functions ---
+// Sign text, can be changed with --sign=TEXT
+std::string signText = "ILOCOS";
+// Number of cloud puffs, can be changed with --cloud-puffs=N
+int cloudPuffCount = 4096;
+// Random boxes for the picking benchmark, set with --pick-bench=N (0 = off)
+int pickBenchCount = 0;
+// Point lights added on top of the scene's lamps, set with --extra-lights=N
+int extraLightCount = 0;
+
+// --- Helper Functions ---
+
+// Linear Interpolation for colors
+void mixColor(float* output, float* c1, float* c2, float t) {
+    output[0] = c1[0] * (1.0f - t) + c2[0] * t;
+    output[1] = c1[1] * (1.0f - t) + c2[1] * t;
+    output[2] = c1[2] * (1.0f - t) + c2[2] * t;
+}
+
+// --- Allocation Tracking ---
+// Every heap allocation in the program goes through the operators below, so
+// the frame stats can show how many allocations (and bytes) each frame made.
+// The counters are read and cleared at every buffer swap.
+
+std::atomic<long long> heapAllocCount(0);
+std::atomic<long long> heapAllocBytes(0);
+
+void* countedAlloc(std::size_t size) {
+    heapAllocCount.fetch_add(1, std::memory_order_relaxed);
+    heapAllocBytes.fetch_add((long long)size, std::memory_order_relaxed);
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(size); }
+    catch (...) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(size); }
+    catch (...) { return nullptr; }
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+// --- Frame Arena ---
+// Bump allocator for data that only lives until the end of the frame. It is
+// reset when the frame goes to glutSwapBuffers, so nothing in it may be kept
+// across frames. If a frame ever needs more than the arena holds, the extra
+// comes from the heap and the arena grows to fit at the next reset.
+
+struct FrameArena {
+    unsigned char* base;
+    size_t capacity;
+    size_t used;
+    size_t peak;             // Most ever used in one frame
+    size_t overflowBytes;    // Requested past the capacity this frame
+    std::vector<void*> overflow;
+};
+
+FrameArena frameArena = {};
+
+void initFrameArena(size_t bytes) {
+    frameArena.base = (unsigned char*)std::malloc(bytes);
+    frameArena.capacity = bytes;
+    frameArena.used = 0;
+}
+
+void* frameArenaAlloc(size_t bytes, size_t align) {
+    size_t start = (frameArena.used + align - 1) & ~(align - 1);
+    if (start + bytes <= frameArena.capacity) {
+        frameArena.used = start + bytes;
+        frameArena.peak = std::max(frameArena.peak, frameArena.used);
+        return frameArena.base + start;
+    }
+    frameArena.overflowBytes += bytes;
+    void* p = ::operator new(bytes);
+    frameArena.overflow.push_back(p);
+    return p;
+}
+
+template <typename T>
+T* frameAlloc(size_t count) {
+    return static_cast<T*>(frameArenaAlloc(count * sizeof(T), alignof(T)));
+}
+
+void resetFrameArena() {
+    for (size_t i = 0; i < frameArena.overflow.size(); i++) ::operator delete(frameArena.overflow[i]);
+    frameArena.overflow.clear();
+    if (frameArena.overflowBytes > 0) {
+        // One-off growth; steady state frames then stay inside the arena
+        size_t bytes = (frameArena.capacity + frameArena.overflowBytes) * 2;
+        std::free(frameArena.base);
+        initFrameArena(bytes);
+        frameArena.overflowBytes = 0;
+    }
+    frameArena.used = 0;
+}
+
+// --- Camera Math ---
+
+void mat4Identity(float* m) {
+    for (int i = 0; i < 16; i++) m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+}
+
+// out = a * b (out may alias a or b)
+void mat4Multiply(float* out, const float* a, const float* b) {
+    float r[16];
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            r[col * 4 + row] = a[row] * b[col * 4] + a[4 + row] * b[col * 4 + 1]
+                + a[8 + row] * b[col * 4 + 2] + a[12 + row] * b[col * 4 + 3];
+        }
+    }
+    std::copy(r, r + 16, out);
+}
+
+// The three below post-multiply m, exactly like glTranslatef / glRotatef / glScalef
+void mat4Translate(float* m, float x, float y, float z) {
+    float t[16];
+    mat4Identity(t);
+    t[12] = x; t[13] = y; t[14] = z;
+    mat4Multiply(m, m, t);
+}
+
+void mat4Rotate(float* m, float angle, float x, float y, float z) {
+    float len = sqrt(x * x + y * y + z * z);
+    if (len == 0.0f) return;
+    x /= len; y /= len; z /= len;
+    float c = cos(angle * PI / 180.0f);
+    float s = sin(angle * PI / 180.0f);
+    float r[16];
+    mat4Identity(r);
+    r[0] = x * x * (1 - c) + c;     r[4] = x * y * (1 - c) - z * s; r[8] = x * z * (1 - c) + y * s;
+    r[1] = y * x * (1 - c) + z * s; r[5] = y * y * (1 - c) + c;     r[9] = y * z * (1 - c) - x * s;
+    r[2] = x * z * (1 - c) - y * s; r[6] = y * z * (1 - c) + x * s; r[10] = z * z * (1 - c) + c;
+    mat4Multiply(m, m, r);
+}
+
+void mat4Scale(float* m, float x, float y, float z) {
+    float t[16];
+    mat4Identity(t);
+    t[0] = x; t[5] = y; t[10] = z;
+    mat4Multiply(m, m, t);
+}
+
+// Same matrix gluPerspective builds
+void mat4Perspective(float* m, float fovy, float aspect, float zNear, float zFar) {
+    float f = 1.0f / tan(fovy * PI / 360.0f);
+    std::fill(m, m + 16, 0.0f);
+    m[0] = f / aspect;
+    m[5] = f;
+    m[10] = (zFar + zNear) / (zNear - zFar);
+    m[11] = -1.0f;
+    m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+}
+
+// out = m * (p, 1)
+void transformPoint(const float* m, const float* p, float* out) {
+    for (int row = 0; row < 4; row++) {
+        out[row] = m[row] * p[0] + m[4 + row] * p[1] + m[8 + row] * p[2] + m[12 + row];
+    }
+}
+
+// out = m * (v, 0), for directions
+void transformDirection(const float* m, const float* v, float* out) {
+    for (int row = 0; row < 3; row++) {
+        out[row] = m[row] * v[0] + m[4 + row] * v[1] + m[8 + row] * v[2];
+    }
+}
+
+// Inverse of a matrix whose last row is (0, 0, 0, 1); returns false if singular
+bool mat4AffineInverse(float* out, const float* m) {
+    float det = m[0] * (m[5] * m[10] - m[9] * m[6]) - m[4] * (m[1] * m[10] - m[9] * m[2])
+        + m[8] * (m[1] * m[6] - m[5] * m[2]);
+    if (det == 0.0f) return false;
+    float inv = 1.0f / det;
+    float r[16];
+    r[0] = (m[5] * m[10] - m[9] * m[6]) * inv;
+    r[4] = (m[8] * m[6] - m[4] * m[10]) * inv;
+    r[8] = (m[4] * m[9] - m[8] * m[5]) * inv;
+    r[1] = (m[9] * m[2] - m[1] * m[10]) * inv;
+    r[5] = (m[0] * m[10] - m[8] * m[2]) * inv;
+    r[9] = (m[8] * m[1] - m[0] * m[9]) * inv;
+    r[2] = (m[1] * m[6] - m[5] * m[2]) * inv;
+    r[6] = (m[4] * m[2] - m[0] * m[6]) * inv;
+    r[10] = (m[0] * m[5] - m[4] * m[1]) * inv;
+    r[3] = r[7] = r[11] = 0.0f;
+    float t[3];
+    transformDirection(r, m + 12, t);
+    r[12] = -t[0]; r[13] = -t[1]; r[14] = -t[2];
+    r[15] = 1.0f;
+    std::copy(r, r + 16, out);
+    return true;
+}
+
+// Rebuilds the view matrix from the same transforms display() applies
+void updateCamera() {
+    mat4Identity(viewMatrix);
+    mat4Translate(viewMatrix, 0.0f, -5.0f, zoom);
+    mat4Rotate(viewMatrix, rotX, 1.0f, 0.0f, 0.0f);
+    mat4Rotate(viewMatrix, rotY, 0.0f, 1.0f, 0.0f);
+    mat4Multiply(viewProjMatrix, projectionMatrix, viewMatrix);
+}
+
+// --- Meshes ---
+// Every solid in the scene is an indexed triangle mesh kept on the CPU.
+// Renderers upload them in whatever form suits the backend.
+
+struct Vertex {
+    float pos[3];
+    float normal[3];
+};
+
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices; // Triangle list
+    bool dynamic;                      // Rebuilt every frame (the water)
+};
+
+std::vector<Mesh> meshes;
+
+int createMesh(bool dynamic) {
+    meshes.push_back(Mesh());
+    meshes.back().dynamic = dynamic;
+    return (int)meshes.size() - 1;
+}
+
+void addVertex(Mesh& m, float x, float y, float z, float nx, float ny, float nz) {
+    Vertex v = { { x, y, z }, { nx, ny, nz } };
+    m.vertices.push_back(v);
+}
+
+void addTriangle(Mesh& m, unsigned int a, unsigned int b, unsigned int c) {
+    m.indices.push_back(a);
+    m.indices.push_back(b);
+    m.indices.push_back(c);
+}
+
+// Two triangles per cell of a (rows + 1) x (cols + 1) vertex grid starting at 'first'
+void addGridIndices(Mesh& m, unsigned int first, int rows, int cols) {
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            unsigned int a = first + i * (cols + 1) + j;
+            unsigned int b = a + cols + 1;
+            addTriangle(m, a, b, b + 1);
+            addTriangle(m, a, b + 1, a + 1);
+        }
+    }
+}
+
+// Unit cube centred on the origin, like glutSolidCube(1)
+void buildCube(Mesh& m) {
+    const float faces[6][9] = {
+        // Normal, U, V (U x V = Normal)
+        { 1, 0, 0,  0, 1, 0,  0, 0, 1 },
+        { -1, 0, 0,  0, 0, 1,  0, 1, 0 },
+        { 0, 1, 0,  0, 0, 1,  1, 0, 0 },
+        { 0, -1, 0,  1, 0, 0,  0, 0, 1 },
+        { 0, 0, 1,  1, 0, 0,  0, 1, 0 },
+        { 0, 0, -1,  0, 1, 0,  1, 0, 0 }
+    };
+    const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+    for (int f = 0; f < 6; f++) {
+        const float* n = faces[f];
+        unsigned int first = (unsigned int)m.vertices.size();
+        for (int c = 0; c < 4; c++) {
+            float p[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = 0.5f * (n[k] + corners[c][0] * n[3 + k] + corners[c][1] * n[6 + k]);
+            }
+            addVertex(m, p[0], p[1], p[2], n[0], n[1], n[2]);
+        }
+        addTriangle(m, first, first + 1, first + 2);
+        addTriangle(m, first, first + 2, first + 3);
+    }
+}
+
+// Unit sphere around the Z axis, like glutSolidSphere(1, slices, stacks)
+void buildSphere(Mesh& m, int slices, int stacks) {
+    for (int i = 0; i <= stacks; i++) {
+        float phi = PI * i / stacks;
+        for (int j = 0; j <= slices; j++) {
+            float theta = 2.0f * PI * j / slices;
+            float x = sin(phi) * cos(theta), y = sin(phi) * sin(theta), z = cos(phi);
+            addVertex(m, x, y, z, x, y, z);
+        }
+    }
+    addGridIndices(m, 0, stacks, slices);
+}
+
+// Cone along +Z with base radius 1 and height 1, like glutSolidCone (base cap included)
+void buildCone(Mesh& m, int slices, int stacks) {
+    float n = 1.0f / sqrt(2.0f);
+    for (int i = 0; i <= stacks; i++) {
+        float z = (float)i / stacks;
+        for (int j = 0; j <= slices; j++) {
+            float theta = 2.0f * PI * j / slices;
+            addVertex(m, (1.0f - z) * cos(theta), (1.0f - z) * sin(theta), z, cos(theta) * n, sin(theta) * n, n);
+        }
+    }
+    addGridIndices(m, 0, stacks, slices);
+
+    unsigned int centre = (unsigned int)m.vertices.size();
+    addVertex(m, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f);
+    for (int j = 0; j <= slices; j++) {
+        float theta = 2.0f * PI * j / slices;
+        addVertex(m, cos(theta), sin(theta), 0.0f, 0.0f, 0.0f, -1.0f);
+    }
+    for (int j = 0; j < slices; j++) addTriangle(m, centre, centre + j + 2, centre + j + 1);
+}
+
+// Open tube along +Z with base radius 1, height 1 and the given top radius, like gluCylinder
+void buildCylinder(Mesh& m, int slices, int stacks, float topRadius) {
+    float slope = 1.0f - topRadius;
+    float len = sqrt(1.0f + slope * slope);
+    for (int i = 0; i <= stacks; i++) {
+        float z = (float)i / stacks;
+        float r = 1.0f - slope * z;
+        for (int j = 0; j <= slices; j++) {
+            float theta = 2.0f * PI * j / slices;
+            addVertex(m, r * cos(theta), r * sin(theta), z, cos(theta) / len, sin(theta) / len, slope / len);
+        }
+    }
+    addGridIndices(m, 0, stacks, slices);
+}
+
+// --- Renderer Backends ---
+// Selected with --renderer=immediate|displaylist|vbo|shader. Every backend is fed
+// the same meshes, matrices and colours by the scene code, so frame statistics
+// (counted in sceneDrawMesh) are identical and only the submission path differs.
+
+// One soft cloud sprite, see Particle Clouds
+struct Puff {
+    float pos[3]; // At cloudOffset 0
+    float size;   // Sprite diameter in world units
+    float shade;  // Brightness variation
+};
+
+const float CLOUD_WRAP_WIDTH = 240.0f; // Matches cloudOffset's -120..120 cycle
+
+// Puff X once drifted by offset, wrapped back into the cloud band
+float wrapCloudX(float x, float offset) {
+    float w = fmod(x + offset + CLOUD_WRAP_WIDTH * 0.5f, CLOUD_WRAP_WIDTH);
+    if (w < 0.0f) w += CLOUD_WRAP_WIDTH;
+    return w - CLOUD_WRAP_WIDTH * 0.5f;
+}
+
+class Renderer {
+public:
+    virtual ~Renderer() {}
+    virtual const char* name() const = 0;
+    // Called once the GL context exists, before any mesh is uploaded
+    virtual bool init() = 0;
+    // Called once a mesh is built, and again every time a dynamic mesh changes
+    virtual void uploadMesh(int id) = 0;
+    virtual void beginFrame(const float* projection, float lightIntensity) = 0;
+    virtual void drawMesh(int id, const float* modelView, const float* color) = 0;
+    virtual void endFrame() {}
+    // Cloud puffs are handed over once, then drawn each frame back to front in
+    // 'order' (orderChanged when it differs from the last call), drifted by offset
+    virtual void uploadPuffs(const std::vector<Puff>& puffs) = 0;
+    virtual void drawPuffs(const std::vector<unsigned int>& order, bool orderChanged,
+        const float* view, float offset, const float* tint) = 0;
+    // Whether the backend shades with the clustered point lights
+    virtual bool shadesPointLights() const { return false; }
+};
+
+Renderer* renderer = nullptr;
+
+// This frame's clustered point lights (see Clustered Lighting). Only the shader
+// backend uses them; the fixed-function backends stay on GL_LIGHT0 alone.
+struct LightClusterState {
+    bool enabled;           // Any lights on this frame
+    bool heatmap;           // Show lights per cluster instead of shading, [L]
+    GLuint lightTexture;    // Buffer textures: light position/radius and colour,
+    GLuint clusterTexture;  // offset and count per cluster,
+    GLuint indexTexture;    // and the light indices they point into
+    int dims[3];            // Tiles across, tiles up, depth slices
+    float tileSize;         // Pixels per tile side
+    float sliceScale, sliceBias; // slice = log(eye distance) * scale + bias
+};
+
+LightClusterState lightClusters = {};
+
+void emitMeshImmediate(const Mesh& m) {
+    glBegin(GL_TRIANGLES);
+    for (size_t i = 0; i < m.indices.size(); i++) {
+        const Vertex& v = m.vertices[m.indices[i]];
+        glNormal3fv(v.normal);
+        glVertex3fv(v.pos);
+    }
+    glEnd();
+}
+
+// Cloud puff corner for the fixed-function backends
+struct SpriteVertex {
+    float pos[3];
+    float uv[2];
+    float color[3];
+};
+
+void emitSpritesImmediate(const std::vector<SpriteVertex>& sprites) {
+    glBegin(GL_QUADS);
+    for (size_t i = 0; i < sprites.size(); i++) {
+        glColor3fv(sprites[i].color);
+        glTexCoord2fv(sprites[i].uv);
+        glVertex3fv(sprites[i].pos);
+    }
+    glEnd();
+}
+
+// Soft round puff, brighter toward the top: the cloud shader's falloff baked into
+// a luminance/alpha texture. Light above 1 is folded into the vertex colour.
+GLuint createPuffTexture() {
+    const int size = 32;
+    unsigned char texels[size * size * 2];
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            float u = (x + 0.5f) / size * 2.0f - 1.0f;
+            float v = (y + 0.5f) / size * 2.0f - 1.0f;
+            float r2 = u * u + v * v;
+            float alpha = r2 > 1.0f ? 0.0f : (1.0f - r2) * (1.0f - r2) * 0.6f;
+            float light = (0.8f + 0.25f * (1.0f - (y + 0.5f) / size)) / 1.05f; // Row 0 is the top
+            texels[(y * size + x) * 2] = (unsigned char)(light * 255.0f);
+            texels[(y * size + x) * 2 + 1] = (unsigned char)(alpha * 255.0f);
+        }
+    }
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, size, size, 0, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, texels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// Shared by the fixed-function backends: GL_LIGHT0 plus glColorMaterial.
+// Cloud puffs become textured, camera-facing quads built on the CPU each frame.
+class FixedFunctionRenderer : public Renderer {
+public:
+    void beginFrame(const float* projection, float lightIntensity) override {
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(projection);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+
+        glEnable(GL_LIGHTING);
+        glEnable(GL_LIGHT0);
+        glEnable(GL_COLOR_MATERIAL);
+        glEnable(GL_NORMALIZE); // Meshes are scaled; keep lighting independent of it
+
+        GLfloat lightDir[] = { 0.0f, 0.0f, 1.0f, 0.0f }; // Toward the viewer, in eye space
+        GLfloat lightColor[] = { lightIntensity, lightIntensity, lightIntensity, 1.0f };
+        glLightfv(GL_LIGHT0, GL_POSITION, lightDir);
+        glLightfv(GL_LIGHT0, GL_DIFFUSE, lightColor);
+        glLightfv(GL_LIGHT0, GL_AMBIENT, lightColor);
+    }
+
+    void drawMesh(int id, const float* modelView, const float* color) override {
+        glLoadMatrixf(modelView);
+        glColor3fv(color);
+        submitMesh(id);
+    }
+
+    void uploadPuffs(const std::vector<Puff>& puffs) override {
+        cloudPuffs = &puffs;
+        sprites.resize(puffs.size() * 4);
+        puffTexture = createPuffTexture();
+    }
+
+    void drawPuffs(const std::vector<unsigned int>& order, bool, const float* view, float offset, const float* tint) override {
+        // The view's right and up axes in world space
+        const float right[3] = { view[0], view[4], view[8] };
+        const float up[3] = { view[1], view[5], view[9] };
+        const float corners[4][2] = { { -1.0f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, -1.0f }, { -1.0f, -1.0f } };
+        for (size_t i = 0; i < order.size(); i++) {
+            const Puff& p = (*cloudPuffs)[order[i]];
+            float center[3] = { wrapCloudX(p.pos[0], offset), p.pos[1], p.pos[2] };
+            float half = p.size * 0.5f;
+            float light = p.shade * 1.05f;
+            for (int c = 0; c < 4; c++) {
+                SpriteVertex& v = sprites[i * 4 + c];
+                for (int k = 0; k < 3; k++) {
+                    v.pos[k] = center[k] + (right[k] * corners[c][0] + up[k] * corners[c][1]) * half;
+                    v.color[k] = std::min(tint[k] * light, 1.0f);
+                }
+                v.uv[0] = corners[c][0] * 0.5f + 0.5f;
+                v.uv[1] = 0.5f - corners[c][1] * 0.5f;
+            }
+        }
+
+        glLoadMatrixf(view);
+        glDisable(GL_LIGHTING);
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, puffTexture);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_ALPHA_TEST); // Corners outside the puff stay out of the depth test and queries
+        glAlphaFunc(GL_GREATER, 0.0f);
+        glDepthMask(GL_FALSE);
+        submitSprites();
+        glDepthMask(GL_TRUE);
+        glDisable(GL_ALPHA_TEST);
+        glDisable(GL_BLEND);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDisable(GL_TEXTURE_2D);
+        glEnable(GL_LIGHTING);
+    }
+
+protected:
+    virtual void submitMesh(int id) = 0;
+    virtual void submitSprites() = 0;
+
+    const std::vector<Puff>* cloudPuffs = nullptr;
+    std::vector<SpriteVertex> sprites; // Four corners per puff, back to front
+    GLuint puffTexture = 0;
+};
+
+// One glBegin/glEnd per mesh, every vertex re-sent every frame
+class ImmediateRenderer : public FixedFunctionRenderer {
+public:
+    const char* name() const override { return "immediate"; }
+    bool init() override { return true; }
+    void uploadMesh(int) override {}
+
+protected:
+    void submitMesh(int id) override { emitMeshImmediate(meshes[id]); }
+    void submitSprites() override { emitSpritesImmediate(sprites); }
+};
+
+// One compiled display list per mesh (recompiled when the water changes)
+class DisplayListRenderer : public FixedFunctionRenderer {
+public:
+    const char* name() const override { return "displaylist"; }
+    bool init() override { return true; }
+
+    void uploadMesh(int id) override {
+        if (id >= (int)lists.size()) lists.resize(id + 1, 0);
+        if (lists[id] == 0) lists[id] = glGenLists(1);
+        glNewList(lists[id], GL_COMPILE);
+        emitMeshImmediate(meshes[id]);
+        glEndList();
+    }
+
+protected:
+    void submitMesh(int id) override { glCallList(lists[id]); }
+
+    // The puffs move every frame, so like the water their list is recompiled each time
+    void submitSprites() override {
+        if (spriteList == 0) spriteList = glGenLists(1);
+        glNewList(spriteList, GL_COMPILE);
+        emitSpritesImmediate(sprites);
+        glEndList();
+        glCallList(spriteList);
+    }
+
+private:
+    std::vector<GLuint> lists;
+    GLuint spriteList = 0;
+};
+
+struct GpuMesh {
+    GLuint vao;
+    GLuint vbo;
+    GLuint ibo;
+    GLsizei indexCount;
+    size_t vboBytes;
+    size_t iboBytes;
+};
+
+// Creates or refreshes the vertex and index buffers of a mesh.
+// Buffers only get reallocated when they grow.
+void uploadMeshBuffers(GpuMesh& gpu, const Mesh& m) {
+    GLenum usage = m.dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+    size_t vboBytes = m.vertices.size() * sizeof(Vertex);
+    size_t iboBytes = m.indices.size() * sizeof(unsigned int);
+    if (gpu.vbo == 0) glGenBuffers(1, &gpu.vbo);
+    if (gpu.ibo == 0) glGenBuffers(1, &gpu.ibo);
+
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.vbo);
+    if (vboBytes > gpu.vboBytes) {
+        glBufferData(GL_ARRAY_BUFFER, vboBytes, m.vertices.data(), usage);
+        gpu.vboBytes = vboBytes;
+    }
+    else if (vboBytes > 0) glBufferSubData(GL_ARRAY_BUFFER, 0, vboBytes, m.vertices.data());
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.ibo);
+    if (iboBytes > gpu.iboBytes) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, iboBytes, m.indices.data(), usage);
+        gpu.iboBytes = iboBytes;
+    }
+    else if (iboBytes > 0) glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, iboBytes, m.indices.data());
+
+    gpu.indexCount = (GLsizei)m.indices.size();
+}
+
+// Vertex buffers drawn through the fixed-function pipeline
+class VboRenderer : public FixedFunctionRenderer {
+public:
+    const char* name() const override { return "vbo"; }
+    bool init() override { return true; }
+
+    void uploadMesh(int id) override {
+        if (id >= (int)gpuMeshes.size()) gpuMeshes.resize(id + 1, GpuMesh());
+        uploadMeshBuffers(gpuMeshes[id], meshes[id]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    void beginFrame(const float* projection, float lightIntensity) override {
+        FixedFunctionRenderer::beginFrame(projection, lightIntensity);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+    }
+
+    void endFrame() override {
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+protected:
+    void submitMesh(int id) override {
+        const GpuMesh& gpu = gpuMeshes[id];
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.vbo);
+        glVertexPointer(3, GL_FLOAT, sizeof(Vertex), (void*)offsetof(Vertex, pos));
+        glNormalPointer(GL_FLOAT, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.ibo);
+        glDrawElements(GL_TRIANGLES, gpu.indexCount, GL_UNSIGNED_INT, 0);
+    }
+
+    // Streamed into one buffer every frame, since every corner moves
+    void submitSprites() override {
+        size_t bytes = sprites.size() * sizeof(SpriteVertex);
+        if (spriteVbo == 0) glGenBuffers(1, &spriteVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, spriteVbo);
+        glBufferData(GL_ARRAY_BUFFER, bytes, sprites.data(), GL_STREAM_DRAW);
+        glVertexPointer(3, GL_FLOAT, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, pos));
+        glTexCoordPointer(2, GL_FLOAT, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, uv));
+        glColorPointer(3, GL_FLOAT, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, color));
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glDrawArrays(GL_QUADS, 0, (GLsizei)sprites.size());
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+    }
+
+private:
+    std::vector<GpuMesh> gpuMeshes;
+    GLuint spriteVbo = 0;
+};
+
+GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint ok = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cerr << "Shader Error: " << log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Returns 0 (after printing the log) if either stage fails
+GLuint linkProgram(const char* vertexSource, const char* fragmentSource) {
+    GLuint vs = compileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if (vs == 0 || fs == 0) return 0;
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        std::cerr << "Program Error: " << log << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Upper 3x3 of the inverse transpose of m: columns are the cross products of m's columns
+void mat3NormalMatrix(const float* m, float* out) {
+    const float* a = m;
+    const float* b = m + 4;
+    const float* c = m + 8;
+    float bc[] = { b[1] * c[2] - b[2] * c[1], b[2] * c[0] - b[0] * c[2], b[0] * c[1] - b[1] * c[0] };
+    float ca[] = { c[1] * a[2] - c[2] * a[1], c[2] * a[0] - c[0] * a[2], c[0] * a[1] - c[1] * a[0] };
+    float ab[] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+    float det = a[0] * bc[0] + a[1] * bc[1] + a[2] * bc[2];
+    if (det == 0.0f) det = 1.0f;
+    for (int k = 0; k < 3; k++) {
+        out[k] = bc[k] / det;
+        out[3 + k] = ca[k] / det;
+        out[6 + k] = ab[k] / det;
+    }
+}
+
+const char* sceneVertexShader =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 position;\n"
+    "layout(location = 1) in vec3 normal;\n"
+    "uniform mat4 modelView;\n"
+    "uniform mat4 projection;\n"
+    "uniform mat3 normalMatrix;\n"
+    "out vec3 eyeNormal;\n"
+    "out vec3 eyePosition;\n"
+    "void main() {\n"
+    "    eyeNormal = normalMatrix * normal;\n"
+    "    vec4 eye = modelView * vec4(position, 1.0);\n"
+    "    eyePosition = eye.xyz;\n"
+    "    gl_Position = projection * eye;\n"
+    "}\n";
+
+// Same model as the fixed-function path: 0.2 global ambient, GL_LIGHT0 ambient
+// and diffuse at lightIntensity, light pointing down the eye-space Z axis.
+// On top of that, the point lights listed for the fragment's cluster.
+const char* sceneFragmentShader =
+    "#version 330 core\n"
+    "in vec3 eyeNormal;\n"
+    "in vec3 eyePosition;\n"
+    "uniform vec3 color;\n"
+    "uniform float lightIntensity;\n"
+    "uniform int clusterMode;\n" // 0 = no point lights, 1 = shade, 2 = heatmap
+    "uniform samplerBuffer pointLights;\n"
+    "uniform usamplerBuffer clusterRanges;\n"
+    "uniform usamplerBuffer clusterLights;\n"
+    "uniform ivec3 clusterDims;\n"
+    "uniform float clusterTileSize;\n"
+    "uniform vec2 clusterSlicing;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    vec3 n = normalize(eyeNormal);\n"
+    "    float diffuse = max(n.z, 0.0);\n"
+    "    vec3 lit = color * (0.2 + lightIntensity + lightIntensity * diffuse);\n"
+    "    if (clusterMode != 0) {\n"
+    "        ivec2 tile = min(ivec2(gl_FragCoord.xy / clusterTileSize), clusterDims.xy - 1);\n"
+    "        int slice = clamp(int(log(-eyePosition.z) * clusterSlicing.x + clusterSlicing.y), 0, clusterDims.z - 1);\n"
+    "        uvec2 range = texelFetch(clusterRanges, (slice * clusterDims.y + tile.y) * clusterDims.x + tile.x).xy;\n"
+    "        if (clusterMode == 2) {\n"
+    "            float heat = min(float(range.y) / 16.0, 1.0);\n"
+    "            lit = mix(vec3(0.0, 0.1, 0.4), vec3(1.0, 0.2, 0.0), heat) * (0.5 + 0.5 * diffuse);\n"
+    "        }\n"
+    "        else {\n"
+    "            for (uint i = 0u; i < range.y; i++) {\n"
+    "                int light = int(texelFetch(clusterLights, int(range.x + i)).r);\n"
+    "                vec4 posRadius = texelFetch(pointLights, light * 2);\n"
+    "                vec3 toLight = posRadius.xyz - eyePosition;\n"
+    "                float dist = length(toLight);\n"
+    "                float falloff = clamp(1.0 - dist / posRadius.w, 0.0, 1.0);\n"
+    "                float facing = max(dot(n, toLight / max(dist, 0.001)), 0.0);\n"
+    "                lit += color * texelFetch(pointLights, light * 2 + 1).rgb * (falloff * falloff * facing);\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    "    fragColor = vec4(min(lit, vec3(1.0)), 1.0);\n"
+    "}\n";
+
+// Cloud puffs as point sprites. Every puff drifts along X with cloudOffset and
+// wraps around here, so the CPU never touches puff positions after start-up.
+const char* cloudVertexShader =
+    "#version 330 core\n"
+    "layout(location = 0) in vec4 puff;\n" // xyz = position at cloudOffset 0, w = diameter
+    "layout(location = 1) in float shade;\n"
+    "uniform mat4 view;\n"
+    "uniform mat4 projection;\n"
+    "uniform float cloudOffset;\n"
+    "uniform float wrapWidth;\n"
+    "uniform float viewportHeight;\n"
+    "out float puffShade;\n"
+    "void main() {\n"
+    "    vec3 p = puff.xyz;\n"
+    "    p.x = mod(p.x + cloudOffset + wrapWidth * 0.5, wrapWidth) - wrapWidth * 0.5;\n"
+    "    gl_Position = projection * view * vec4(p, 1.0);\n"
+    "    float pixels = puff.w * projection[1][1] * viewportHeight * 0.5 / max(gl_Position.w, 0.1);\n"
+    "    gl_PointSize = clamp(pixels, 1.0, 256.0);\n"
+    "    puffShade = shade;\n"
+    "}\n";
+
+const char* cloudFragmentShader =
+    "#version 330 core\n"
+    "in float puffShade;\n"
+    "uniform vec3 tint;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    vec2 c = gl_PointCoord * 2.0 - 1.0;\n"
+    "    float r2 = dot(c, c);\n"
+    "    if (r2 > 1.0) discard;\n"
+    "    float alpha = (1.0 - r2) * (1.0 - r2) * 0.6;\n"   // Soft round edge
+    "    float light = mix(0.8, 1.05, 1.0 - gl_PointCoord.y) * puffShade;\n" // Lit from above
+    "    fragColor = vec4(min(tint * light, vec3(1.0)), alpha);\n"
+    "}\n";
+
+// Core-profile path: VAOs and GLSL 3.30, no fixed-function state at all
+class ShaderRenderer : public Renderer {
+public:
+    const char* name() const override { return "shader"; }
+
+    bool init() override {
+        program = linkProgram(sceneVertexShader, sceneFragmentShader);
+        if (program == 0) return false;
+        modelViewLoc = glGetUniformLocation(program, "modelView");
+        projectionLoc = glGetUniformLocation(program, "projection");
+        normalMatrixLoc = glGetUniformLocation(program, "normalMatrix");
+        colorLoc = glGetUniformLocation(program, "color");
+        lightIntensityLoc = glGetUniformLocation(program, "lightIntensity");
+        clusterModeLoc = glGetUniformLocation(program, "clusterMode");
+        clusterDimsLoc = glGetUniformLocation(program, "clusterDims");
+        clusterTileSizeLoc = glGetUniformLocation(program, "clusterTileSize");
+        clusterSlicingLoc = glGetUniformLocation(program, "clusterSlicing");
+        // The cluster buffer textures live on units 0..2
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "pointLights"), 0);
+        glUniform1i(glGetUniformLocation(program, "clusterRanges"), 1);
+        glUniform1i(glGetUniformLocation(program, "clusterLights"), 2);
+        glUseProgram(0);
+        return true;
+    }
+
+    bool shadesPointLights() const override { return true; }
+
+    void uploadMesh(int id) override {
+        if (id >= (int)gpuMeshes.size()) gpuMeshes.resize(id + 1, GpuMesh());
+        GpuMesh& gpu = gpuMeshes[id];
+        bool fresh = gpu.vao == 0;
+        if (fresh) glGenVertexArrays(1, &gpu.vao);
+        glBindVertexArray(gpu.vao);
+        uploadMeshBuffers(gpu, meshes[id]);
+        if (fresh) {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pos));
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+            glEnableVertexAttribArray(0);
+            glEnableVertexAttribArray(1);
+        }
+        glBindVertexArray(0);
+    }
+
+    void beginFrame(const float* projection, float lightIntensity) override {
+        std::copy(projection, projection + 16, frameProjection);
+        glUseProgram(program);
+        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, projection);
+        glUniform1f(lightIntensityLoc, lightIntensity);
+
+        const LightClusterState& lc = lightClusters;
+        glUniform1i(clusterModeLoc, !lc.enabled ? 0 : (lc.heatmap ? 2 : 1));
+        if (!lc.enabled) return;
+        glUniform3i(clusterDimsLoc, lc.dims[0], lc.dims[1], lc.dims[2]);
+        glUniform1f(clusterTileSizeLoc, lc.tileSize);
+        glUniform2f(clusterSlicingLoc, lc.sliceScale, lc.sliceBias);
+        GLuint textures[3] = { lc.lightTexture, lc.clusterTexture, lc.indexTexture };
+        for (int unit = 0; unit < 3; unit++) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[unit]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void drawMesh(int id, const float* modelView, const float* color) override {
+        float normalMatrix[9];
+        mat3NormalMatrix(modelView, normalMatrix);
+        glUniformMatrix4fv(modelViewLoc, 1, GL_FALSE, modelView);
+        glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, normalMatrix);
+        glUniform3fv(colorLoc, 1, color);
+        glBindVertexArray(gpuMeshes[id].vao);
+        glDrawElements(GL_TRIANGLES, gpuMeshes[id].indexCount, GL_UNSIGNED_INT, 0);
+    }
+
+    void endFrame() override {
+        glBindVertexArray(0);
+        glUseProgram(0);
+    }
+
+    // One vertex per puff; the sorted order is the index buffer
+    void uploadPuffs(const std::vector<Puff>& puffs) override {
+        cloudProgram = linkProgram(cloudVertexShader, cloudFragmentShader);
+        if (cloudProgram == 0) return;
+        cloudViewLoc = glGetUniformLocation(cloudProgram, "view");
+        cloudProjectionLoc = glGetUniformLocation(cloudProgram, "projection");
+        cloudOffsetLoc = glGetUniformLocation(cloudProgram, "cloudOffset");
+        cloudWrapLoc = glGetUniformLocation(cloudProgram, "wrapWidth");
+        cloudViewportLoc = glGetUniformLocation(cloudProgram, "viewportHeight");
+        cloudTintLoc = glGetUniformLocation(cloudProgram, "tint");
+
+        // Unsorted to begin with; the first sort replaces it
+        std::vector<unsigned int> order(puffs.size());
+        for (size_t i = 0; i < puffs.size(); i++) order[i] = (unsigned int)i;
+        cloudCount = (GLsizei)puffs.size();
+
+        glGenVertexArrays(1, &cloudVao);
+        glBindVertexArray(cloudVao);
+        glGenBuffers(1, &cloudVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, cloudVbo);
+        glBufferData(GL_ARRAY_BUFFER, puffs.size() * sizeof(Puff), puffs.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Puff), (void*)offsetof(Puff, pos));
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(Puff), (void*)offsetof(Puff, shade));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glGenBuffers(1, &cloudIbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cloudIbo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, order.size() * sizeof(unsigned int), order.data(), GL_DYNAMIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void drawPuffs(const std::vector<unsigned int>& order, bool orderChanged,
+        const float* view, float offset, const float* tint) override {
+        if (cloudProgram == 0) return;
+        glBindVertexArray(cloudVao);
+        if (orderChanged) glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, order.size() * sizeof(unsigned int), order.data());
+
+        glUseProgram(cloudProgram);
+        glUniformMatrix4fv(cloudViewLoc, 1, GL_FALSE, view);
+        glUniformMatrix4fv(cloudProjectionLoc, 1, GL_FALSE, frameProjection);
+        glUniform1f(cloudOffsetLoc, offset);
+        glUniform1f(cloudWrapLoc, CLOUD_WRAP_WIDTH);
+        glUniform1f(cloudViewportLoc, (float)viewportHeight);
+        glUniform3fv(cloudTintLoc, 1, tint);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glDrawElements(GL_POINTS, cloudCount, GL_UNSIGNED_INT, 0);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+
+        glUseProgram(program);
+    }
+
+private:
+    GLuint program = 0;
+    GLint modelViewLoc = -1, projectionLoc = -1, normalMatrixLoc = -1;
+    GLint colorLoc = -1, lightIntensityLoc = -1;
+    GLint clusterModeLoc = -1, clusterDimsLoc = -1, clusterTileSizeLoc = -1, clusterSlicingLoc = -1;
+    std::vector<GpuMesh> gpuMeshes;
+    float frameProjection[16] = {};
+
+    GLuint cloudProgram = 0, cloudVao = 0, cloudVbo = 0, cloudIbo = 0;
+    GLsizei cloudCount = 0;
+    GLint cloudViewLoc = -1, cloudProjectionLoc = -1, cloudOffsetLoc = -1;
+    GLint cloudWrapLoc = -1, cloudViewportLoc = -1, cloudTintLoc = -1;
+};
+
+// Returns nullptr for an unknown backend name
+Renderer* createRenderer(const std::string& backend) {
+    if (backend == "immediate") return new ImmediateRenderer();
+    if (backend == "displaylist") return new DisplayListRenderer();
+    if (backend == "vbo") return new VboRenderer();
+    if (backend == "shader") return new ShaderRenderer();
+    return nullptr;
+}
+
+// --- Input Latency ---
+// Mouse motion is not applied as it arrives. mouseMotion keeps only the latest
+// cursor position plus the arrival time of every event, and display() turns
+// that into one camera update per frame. Right after the buffer swap the frame
+// gets a GPU timestamp query and a fence. Once the fence has signalled (polled,
+// never waited on), the timestamp says when the GPU finished the frame that
+// first showed those events, and each event's latency goes into a histogram.
+// Scan-out adds up to one more refresh on top of what is measured here.
+
+const int LATENCY_FRAMES = 4;     // Frames tracked while in flight
+const int MAX_FRAME_EVENTS = 64;  // Events timed per frame; extra ones are still applied
+const float LATENCY_BUCKET_MS = 0.25f;
+const int LATENCY_BUCKETS = 400;  // The last bucket also takes anything slower
+
+struct LatencyFrame {
+    bool pending;
+    GLsync fence;
+    GLuint query;
+    int eventCount;
+    long long eventNs[MAX_FRAME_EVENTS];
+};
+
+bool motionPending = false;
+float motionX = 0.0f, motionY = 0.0f; // Latest drag position, not yet applied
+long long frameEventNs[MAX_FRAME_EVENTS]; // Events waiting for the next frame
+int frameEventCount = 0;
+LatencyFrame latencyFrames[LATENCY_FRAMES];
+int latencyFrameIndex = 0;
+bool gpuLatencySupported = false;
+long long gpuClockOffsetNs = 0; // steady_clock minus GL_TIMESTAMP
+
+// Reset with the other statistics about once a second
+int latencyHistogram[LATENCY_BUCKETS];
+int latencySamples = 0;
+int inputEvents = 0;
+int inputFrames = 0;     // Frames that applied at least one event
+int latencyDropped = 0;  // Frames not timed because every slot was in flight
+
+long long nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void recordInputEvent() {
+    if (frameEventCount < MAX_FRAME_EVENTS) frameEventNs[frameEventCount++] = nowNs();
+    inputEvents++;
+}
+
+// GL_TIMESTAMP and steady_clock drift apart slowly, so this is redone every second
+void calibrateGpuClock() {
+    if (!gpuLatencySupported) return;
+    GLint64 gpuNs = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNs);
+    gpuClockOffsetNs = nowNs() - gpuNs;
+}
+
+void initLatencyTracking() {
+    gpuLatencySupported = (GLEW_VERSION_3_3 || GLEW_ARB_timer_query) && (GLEW_VERSION_3_2 || GLEW_ARB_sync);
+    if (!gpuLatencySupported) return; // Falls back to when glutSwapBuffers returns
+    for (int i = 0; i < LATENCY_FRAMES; i++) glGenQueries(1, &latencyFrames[i].query);
+    calibrateGpuClock();
+}
+
+// Merges the motion that arrived since the last frame into one camera update
+void applyPendingInput() {
+    if (!motionPending) return;
+    rotY += (motionX - lastX) * 0.5f;
+    rotX += (motionY - lastY) * 0.5f;
+    lastX = motionX;
+    lastY = motionY;
+    motionPending = false;
+}
+
+void addLatencySample(long long eventNs, long long shownNs) {
+    float ms = (shownNs - eventNs) / 1.0e6f;
+    int bucket = std::max(0, std::min(LATENCY_BUCKETS - 1, (int)(ms / LATENCY_BUCKET_MS)));
+    latencyHistogram[bucket]++;
+    latencySamples++;
+}
+
+// Upper edge of the bucket holding the given fraction of this second's samples
+float latencyPercentile(float fraction) {
+    if (latencySamples == 0) return 0.0f;
+    int target = std::max(1, (int)ceil(fraction * latencySamples));
+    int seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += latencyHistogram[b];
+        if (seen >= target) return (b + 1) * LATENCY_BUCKET_MS;
+    }
+    return LATENCY_BUCKETS * LATENCY_BUCKET_MS;
+}
+
+void resetLatencyStats() {
+    std::fill(latencyHistogram, latencyHistogram + LATENCY_BUCKETS, 0);
+    latencySamples = 0;
+    inputEvents = 0;
+    inputFrames = 0;
+    latencyDropped = 0;
+}
+
+// Scores every tracked frame the GPU has finished
+void collectLatencyFrames() {
+    for (int i = 0; i < LATENCY_FRAMES; i++) {
+        LatencyFrame& f = latencyFrames[i];
+        if (!f.pending) continue;
+        GLenum state = glClientWaitSync(f.fence, 0, 0);
+        if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED) continue;
+        glDeleteSync(f.fence);
+        GLuint64 gpuNs = 0;
+        glGetQueryObjectui64v(f.query, GL_QUERY_RESULT, &gpuNs); // Done: it came before the fence
+        long long shownNs = (long long)gpuNs + gpuClockOffsetNs;
+        for (int e = 0; e < f.eventCount; e++) addLatencySample(f.eventNs[e], shownNs);
+        f.pending = false;
+    }
+}
+
+// Called right after glutSwapBuffers
+void endLatencyFrame() {
+    if (gpuLatencySupported) collectLatencyFrames();
+    if (frameEventCount == 0) return;
+    inputFrames++;
+
+    if (!gpuLatencySupported) {
+        long long shownNs = nowNs();
+        for (int e = 0; e < frameEventCount; e++) addLatencySample(frameEventNs[e], shownNs);
+        frameEventCount = 0;
+        return;
+    }
+
+    LatencyFrame& f = latencyFrames[latencyFrameIndex];
+    if (f.pending) {
+        latencyDropped++;
+        frameEventCount = 0;
+        return;
+    }
+    glQueryCounter(f.query, GL_TIMESTAMP);
+    f.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    std::copy(frameEventNs, frameEventNs + frameEventCount, f.eventNs);
+    f.eventCount = frameEventCount;
+    f.pending = true;
+    latencyFrameIndex = (latencyFrameIndex + 1) % LATENCY_FRAMES;
+    frameEventCount = 0;
+}
+
+// --- Frame Statistics ---
+
+struct FrameStats {
+    int drawCalls;
+    int triangles;
+    float cpuMs; // display() up to the buffer swap
+    int cloudPuffs;
+    int cloudSorts;    // Finished so far (worker thread)
+    float cloudSortMs; // Time the last one took
+    long long heapAllocs; // Swap to swap, all threads
+    long long heapBytes;
+    size_t arenaUsed;
+    int occlusionTested;
+    int cpuOccluded;
+    int gpuOccluded;
+    int pointLights;
+    int lightsBinned;     // In front of the camera and on screen
+    int clusterLightRefs; // Light list entries over all clusters
+    int clustersLit;      // Clusters with at least one light
+    int maxClusterLights; // Worst case lights one fragment loops over
+    int lightsDropped;    // Did not fit in a full cluster
+    int clustersFull;     // Clusters that hit MAX_LIGHTS_PER_CLUSTER
+    float lightBinMs;
+    int terrainTiles;   // Drawn
+    int terrainBuilt;   // Meshed this frame
+    int terrainPending; // Waiting for their heights
+    int terrainEvicted; // Mesh slots taken from another tile
+    int picks;          // Clicks resolved since the last print
+    float pickUs;       // Ray cast time of the latest one
+    int pickNodes;      // BVH nodes it visited
+};
+
+FrameStats frameStats = {};
+int textMeshCount = 0; // Totals over the text mesh cache, kept across frames
+long long textMeshBlocks = 0;
+long long textMeshTriangles = 0;
+int pickCount = 0; // Set by pickAt, read into frameStats
+float lastPickUs = 0.0f;
+int lastPickNodes = 0;
+bool printStats = false;  // Toggled with [P]
+int statsFrames = 0;
+int statsLastPrint = 0;
+
+// GPU frame time, measured with two timer queries used in turn so reading
+// one never waits on the frame that is still in flight
+bool timerQueriesSupported = false;
+GLuint frameTimerQueries[2];
+bool frameTimerPending[2] = { false, false };
+int frameTimerIndex = 0;
+bool frameTimerRunning = false; // A query was begun this frame
+float lastGpuMs = 0.0f;
+
+void initFrameTimer() {
+    timerQueriesSupported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (timerQueriesSupported) glGenQueries(2, frameTimerQueries);
+}
+
+void beginFrameTimer() {
+    frameTimerRunning = false;
+    if (!timerQueriesSupported) return;
+    frameTimerIndex = 1 - frameTimerIndex;
+    GLuint query = frameTimerQueries[frameTimerIndex];
+    if (frameTimerPending[frameTimerIndex]) {
+        GLuint ready = 0;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) return; // Skip timing this frame rather than wait
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        lastGpuMs = ns / 1.0e6f;
+        frameTimerPending[frameTimerIndex] = false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    frameTimerPending[frameTimerIndex] = true;
+    frameTimerRunning = true;
+}
+
+void endFrameTimer() {
+    if (frameTimerRunning) glEndQuery(GL_TIME_ELAPSED);
+}
+
+// Called once per frame; prints the latest frame's numbers about once a second
+void reportFrameStats() {
+    frameStats.heapAllocs = heapAllocCount.exchange(0);
+    frameStats.heapBytes = heapAllocBytes.exchange(0);
+    frameStats.arenaUsed = frameArena.used;
+    frameStats.picks = pickCount;
+    frameStats.pickUs = lastPickUs;
+    frameStats.pickNodes = lastPickNodes;
+    statsFrames++;
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    if (printStats && now - statsLastPrint >= 1000) {
+        float fps = statsFrames * 1000.0f / (now - statsLastPrint);
+        std::cout << "[stats] " << renderer->name() << " | " << fps << " fps | cpu " << frameStats.cpuMs
+            << " ms, gpu " << lastGpuMs << " ms | " << frameStats.drawCalls << " draws, "
+            << frameStats.triangles << " tris | occlusion: tested " << frameStats.occlusionTested
+            << ", cpu-occluded " << frameStats.cpuOccluded
+            << ", gpu-occluded " << frameStats.gpuOccluded
+            << " | lights: " << frameStats.lightsBinned << "/" << frameStats.pointLights << " binned, "
+            << frameStats.clusterLightRefs << " refs in " << frameStats.clustersLit << " clusters (avg "
+            << (frameStats.clustersLit > 0 ? (float)frameStats.clusterLightRefs / frameStats.clustersLit : 0.0f)
+            << ", max " << frameStats.maxClusterLights << ", dropped " << frameStats.lightsDropped << " in "
+            << frameStats.clustersFull << " full clusters), bin "
+            << frameStats.lightBinMs << " ms"
+            << " | terrain: " << frameStats.terrainTiles << " tiles, " << frameStats.terrainBuilt << " built, "
+            << frameStats.terrainPending << " pending, " << frameStats.terrainEvicted << " evicted"
+            << " | clouds: " << frameStats.cloudPuffs << " puffs, " << frameStats.cloudSorts << " sorts, last "
+            << frameStats.cloudSortMs << " ms"
+            << " | text: " << textMeshCount << " meshes, " << textMeshTriangles << " tris (" << textMeshBlocks
+            << " blocks, " << textMeshBlocks * 12 << " tris unmerged)"
+            << " | picks: " << frameStats.picks << ", last " << frameStats.pickUs << " us, "
+            << frameStats.pickNodes << " nodes"
+            << " | input: " << inputEvents << " events in " << inputFrames << " frames, latency p50 "
+            << latencyPercentile(0.5f) << " ms, p99 " << latencyPercentile(0.99f) << " ms (" << latencySamples
+            << (gpuLatencySupported ? " gpu-timed" : " swap-timed") << ", " << latencyDropped << " untimed frames)"
+            << " | heap: " << frameStats.heapAllocs << " allocs, " << frameStats.heapBytes << " bytes"
+            << " | arena: " << frameStats.arenaUsed / 1024 << "/" << frameArena.capacity / 1024 << " KB, peak "
+            << frameArena.peak / 1024 << " KB" << std::endl;
+    }
+    if (now - statsLastPrint >= 1000) {
+        statsLastPrint = now;
+        statsFrames = 0;
+        resetLatencyStats();
+        calibrateGpuClock();
+        pickCount = 0;
+    }
+    frameStats = FrameStats();
+}
+
+// --- Clustered Lighting ---
+// The night scene has far more point lights (windmill lamps, beach lamps,
+// lanterns, the sign's glow) than fixed-function GL can take. The view frustum
+// is cut into screen tiles of CLUSTER_TILE_PIXELS and CLUSTER_SLICES depth
+// slices spaced logarithmically. Every frame each light's sphere is binned into
+// the clusters it touches, with the slices split over worker threads, and the
+// fragment shader only loops over the lights listed for its own cluster.
+
+const int CLUSTER_TILE_PIXELS = 64;
+const int CLUSTER_SLICES = 24;
+const float CLUSTER_NEAR = 0.1f;        // Same planes as the projection in reshape
+const float CLUSTER_FAR = 2000.0f;
+const float CLUSTER_FIRST_SLICE = 1.0f; // Slice 0 is everything nearer than this
+const int MAX_LIGHTS_PER_CLUSTER = 64;
+const int MAX_POINT_LIGHTS = 4096;
+
+struct PointLight {
+    float pos[3];   // World space
+    float radius;   // Falls off to nothing here
+    float color[3]; // Brightness included
+};
+
+// A light that survived this frame's frustum check, in view space
+struct BinnedLight {
+    float center[3];
+    float radius;
+    int tileMin[2], tileMax[2];
+    int sliceMin, sliceMax;
+};
+
+std::vector<PointLight> pointLights; // Refilled by the scene every frame
+bool clusteredLightingSupported = false;
+
+int clusterCount = 0;
+std::vector<float> clusterBounds;               // View-space min xyz, max xyz per cluster
+std::vector<int> clusterLightCount;
+std::vector<unsigned short> clusterLightSlots;  // MAX_LIGHTS_PER_CLUSTER per cluster
+std::vector<GLuint> clusterRanges;              // Offset and count per cluster, uploaded
+GLuint lightBuffers[3];                         // Backing lightClusters' three textures
+
+BinnedLight* binnedLights = nullptr;
+int binnedLightCount = 0;
+int sliceDroppedLights[CLUSTER_SLICES];         // Full clusters, per slice
+bool warnedFullClusters = false;                // Said once on the console
+
+// Binning workers; the render thread takes the first share of slices itself
+std::vector<std::thread> lightBinThreads;
+std::mutex lightBinMutex;
+std::condition_variable lightBinWake;
+std::condition_variable lightBinDone;
+int lightBinGeneration = 0;
+int lightBinPending = 0;
+bool lightBinQuit = false;
+
+int depthSlice(float distance) {
+    int slice = (int)floor(log(std::max(distance, CLUSTER_NEAR)) * lightClusters.sliceScale + lightClusters.sliceBias);
+    return std::max(0, std::min(CLUSTER_SLICES - 1, slice));
+}
+
+float sliceStart(int slice) {
+    if (slice == 0) return CLUSTER_NEAR;
+    return exp((slice - lightClusters.sliceBias) / lightClusters.sliceScale);
+}
+
+// Recomputes every cluster's view-space box; called from reshape
+void resizeLightClusters(int w, int h) {
+    if (!clusteredLightingSupported) return;
+    LightClusterState& lc = lightClusters;
+    lc.tileSize = (float)CLUSTER_TILE_PIXELS;
+    lc.dims[0] = (w + CLUSTER_TILE_PIXELS - 1) / CLUSTER_TILE_PIXELS;
+    lc.dims[1] = (h + CLUSTER_TILE_PIXELS - 1) / CLUSTER_TILE_PIXELS;
+    lc.dims[2] = CLUSTER_SLICES;
+    // Slice 1 starts at CLUSTER_FIRST_SLICE and the last one ends at CLUSTER_FAR
+    lc.sliceScale = (CLUSTER_SLICES - 1) / log(CLUSTER_FAR / CLUSTER_FIRST_SLICE);
+    lc.sliceBias = 1.0f - log(CLUSTER_FIRST_SLICE) * lc.sliceScale;
+
+    clusterCount = lc.dims[0] * lc.dims[1] * lc.dims[2];
+    clusterBounds.resize(clusterCount * 6);
+    clusterLightCount.resize(clusterCount);
+    clusterLightSlots.resize(clusterCount * MAX_LIGHTS_PER_CLUSTER);
+    clusterRanges.resize(clusterCount * 2);
+
+    for (int slice = 0; slice < CLUSTER_SLICES; slice++) {
+        float depths[2] = { sliceStart(slice), slice + 1 < CLUSTER_SLICES ? sliceStart(slice + 1) : CLUSTER_FAR };
+        for (int ty = 0; ty < lc.dims[1]; ty++) {
+            for (int tx = 0; tx < lc.dims[0]; tx++) {
+                float ndc[2][2] = {
+                    { 2.0f * tx * CLUSTER_TILE_PIXELS / w - 1.0f, 2.0f * std::min((tx + 1) * CLUSTER_TILE_PIXELS, w) / w - 1.0f },
+                    { 2.0f * ty * CLUSTER_TILE_PIXELS / h - 1.0f, 2.0f * std::min((ty + 1) * CLUSTER_TILE_PIXELS, h) / h - 1.0f }
+                };
+                float* b = &clusterBounds[((slice * lc.dims[1] + ty) * lc.dims[0] + tx) * 6];
+                b[0] = b[1] = b[2] = 1e30f;
+                b[3] = b[4] = b[5] = -1e30f;
+                for (int c = 0; c < 8; c++) {
+                    float d = depths[c >> 2];
+                    float p[3] = { ndc[0][c & 1] * d / projectionMatrix[0], ndc[1][(c >> 1) & 1] * d / projectionMatrix[5], -d };
+                    for (int a = 0; a < 3; a++) {
+                        b[a] = std::min(b[a], p[a]);
+                        b[3 + a] = std::max(b[3 + a], p[a]);
+                    }
+                }
+            }
+        }
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffers[1]);
+    glBufferData(GL_TEXTURE_BUFFER, clusterRanges.size() * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffers[2]);
+    glBufferData(GL_TEXTURE_BUFFER, clusterCount * MAX_LIGHTS_PER_CLUSTER * sizeof(unsigned short), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Bins every light into its clusters for one share of the depth slices
+void binLightSlices(int part, int parts) {
+    const LightClusterState& lc = lightClusters;
+    int first = part * CLUSTER_SLICES / parts;
+    int last = (part + 1) * CLUSTER_SLICES / parts;
+    for (int slice = first; slice < last; slice++) {
+        sliceDroppedLights[slice] = 0;
+        for (int i = 0; i < binnedLightCount; i++) {
+            const BinnedLight& light = binnedLights[i];
+            if (slice < light.sliceMin || slice > light.sliceMax) continue;
+            float r2 = light.radius * light.radius;
+            for (int ty = light.tileMin[1]; ty <= light.tileMax[1]; ty++) {
+                for (int tx = light.tileMin[0]; tx <= light.tileMax[0]; tx++) {
+                    int cluster = (slice * lc.dims[1] + ty) * lc.dims[0] + tx;
+                    // Sphere against the cluster's box
+                    const float* b = &clusterBounds[cluster * 6];
+                    float d2 = 0.0f;
+                    for (int a = 0; a < 3; a++) {
+                        float nearest = std::max(b[a], std::min(light.center[a], b[3 + a]));
+                        d2 += (light.center[a] - nearest) * (light.center[a] - nearest);
+                    }
+                    if (d2 > r2) continue;
+                    int& count = clusterLightCount[cluster];
+                    if (count == MAX_LIGHTS_PER_CLUSTER) { sliceDroppedLights[slice]++; continue; }
+                    clusterLightSlots[cluster * MAX_LIGHTS_PER_CLUSTER + count++] = (unsigned short)i;
+                }
+            }
+        }
+    }
+}
+
+void lightBinWorker(int part) {
+    int seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(lightBinMutex);
+            lightBinWake.wait(lock, [&] { return lightBinQuit || lightBinGeneration != seen; });
+            if (lightBinQuit) return;
+            seen = lightBinGeneration;
+        }
+        binLightSlices(part, (int)lightBinThreads.size() + 1);
+        std::lock_guard<std::mutex> lock(lightBinMutex);
+        if (--lightBinPending == 0) lightBinDone.notify_one();
+    }
+}
+
+void shutdownClusteredLighting() {
+    {
+        std::lock_guard<std::mutex> lock(lightBinMutex);
+        lightBinQuit = true;
+    }
+    lightBinWake.notify_all();
+    for (std::thread& t : lightBinThreads) t.join();
+    lightBinThreads.clear();
+}
+
+void initClusteredLighting() {
+    clusteredLightingSupported = renderer->shadesPointLights() && GLEW_VERSION_3_1; // Buffer textures
+    if (!clusteredLightingSupported) {
+        std::cout << " Point lights need --renderer=shader; this backend keeps the single GL light" << std::endl;
+        return;
+    }
+    pointLights.reserve(MAX_POINT_LIGHTS);
+
+    // The cluster buffers are sized in resizeLightClusters; glTexBuffer needs them to exist now
+    glGenBuffers(3, lightBuffers);
+    for (int i = 0; i < 3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, lightBuffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, i == 0 ? MAX_POINT_LIGHTS * 8 * sizeof(float) : 16, nullptr, GL_STREAM_DRAW);
+    }
+    GLuint textures[3];
+    glGenTextures(3, textures);
+    const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+    for (int i = 0; i < 3; i++) {
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], lightBuffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    lightClusters.lightTexture = textures[0];
+    lightClusters.clusterTexture = textures[1];
+    lightClusters.indexTexture = textures[2];
+
+    int workers = std::max(0, std::min(7, (int)std::thread::hardware_concurrency() - 1));
+    for (int i = 0; i < workers; i++) lightBinThreads.push_back(std::thread(lightBinWorker, i + 1));
+    atexit(shutdownClusteredLighting);
+    std::cout << " Point lights: clustered, " << workers + 1 << " binning threads" << std::endl;
+}
+
+// Bins this frame's pointLights against the current view and uploads the lists
+void binLightClusters() {
+    LightClusterState& lc = lightClusters;
+    lc.enabled = false;
+    if (!clusteredLightingSupported || clusterCount == 0 || pointLights.empty()) return;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // View-space spheres and the slice / tile range they can touch, plus two RGBA
+    // texels each (position and radius, colour) for the shader
+    binnedLights = frameAlloc<BinnedLight>(pointLights.size());
+    float* lightTexels = frameAlloc<float>(pointLights.size() * 8);
+    binnedLightCount = 0;
+    for (const PointLight& light : pointLights) {
+        float c[4];
+        transformPoint(viewMatrix, light.pos, c);
+        float r = light.radius;
+        float dNear = -c[2] - r, dFar = -c[2] + r;
+        if (dFar < CLUSTER_NEAR || dNear > CLUSTER_FAR) continue;
+
+        BinnedLight& b = binnedLights[binnedLightCount];
+        std::copy(c, c + 3, b.center);
+        b.radius = r;
+        b.sliceMin = depthSlice(dNear);
+        b.sliceMax = depthSlice(dFar);
+        b.tileMin[0] = b.tileMin[1] = 0;
+        b.tileMax[0] = lc.dims[0] - 1;
+        b.tileMax[1] = lc.dims[1] - 1;
+        if (dNear > CLUSTER_NEAR) {
+            // x / depth is monotonic in depth, so the extremes are at dNear or dFar
+            bool offScreen = false;
+            for (int a = 0; a < 2; a++) {
+                float scale = projectionMatrix[a * 5];
+                float lo = std::min((c[a] - r) / dNear, (c[a] - r) / dFar) * scale;
+                float hi = std::max((c[a] + r) / dNear, (c[a] + r) / dFar) * scale;
+                if (lo > 1.0f || hi < -1.0f) offScreen = true;
+                float size = (float)(a == 0 ? viewportWidth : viewportHeight);
+                b.tileMin[a] = std::max(b.tileMin[a], (int)floor((lo * 0.5f + 0.5f) * size / CLUSTER_TILE_PIXELS));
+                b.tileMax[a] = std::min(b.tileMax[a], (int)floor((hi * 0.5f + 0.5f) * size / CLUSTER_TILE_PIXELS));
+            }
+            if (offScreen) continue;
+        }
+
+        float* texel = &lightTexels[binnedLightCount * 8];
+        std::copy(c, c + 3, texel);
+        texel[3] = r;
+        std::copy(light.color, light.color + 3, texel + 4);
+        texel[7] = 0.0f;
+        binnedLightCount++;
+    }
+
+    std::fill(clusterLightCount.begin(), clusterLightCount.end(), 0);
+    int parts = (int)lightBinThreads.size() + 1;
+    if (parts > 1) {
+        {
+            std::lock_guard<std::mutex> lock(lightBinMutex);
+            lightBinGeneration++;
+            lightBinPending = parts - 1;
+        }
+        lightBinWake.notify_all();
+    }
+    binLightSlices(0, parts);
+    if (parts > 1) {
+        std::unique_lock<std::mutex> lock(lightBinMutex);
+        lightBinDone.wait(lock, [] { return lightBinPending == 0; });
+    }
+
+    // Pack the lists back to back for the shader, sized to this frame's total
+    int used = 0, lit = 0, maxLights = 0, full = 0;
+    for (int cluster = 0; cluster < clusterCount; cluster++) {
+        int count = clusterLightCount[cluster];
+        clusterRanges[cluster * 2] = used;
+        clusterRanges[cluster * 2 + 1] = count;
+        used += count;
+        if (count > 0) lit++;
+        if (count == MAX_LIGHTS_PER_CLUSTER) full++;
+        maxLights = std::max(maxLights, count);
+    }
+    unsigned short* clusterIndices = frameAlloc<unsigned short>(used);
+    for (int cluster = 0; cluster < clusterCount; cluster++) {
+        const unsigned short* slots = &clusterLightSlots[cluster * MAX_LIGHTS_PER_CLUSTER];
+        std::copy(slots, slots + clusterLightCount[cluster], clusterIndices + clusterRanges[cluster * 2]);
+    }
+
+    // Orphan and refill, so the GPU can keep reading last frame's lists
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffers[0]);
+    glBufferData(GL_TEXTURE_BUFFER, MAX_POINT_LIGHTS * 8 * sizeof(float), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, binnedLightCount * 8 * sizeof(float), lightTexels);
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffers[1]);
+    glBufferData(GL_TEXTURE_BUFFER, clusterRanges.size() * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, clusterRanges.size() * sizeof(GLuint), clusterRanges.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffers[2]);
+    glBufferData(GL_TEXTURE_BUFFER, clusterCount * MAX_LIGHTS_PER_CLUSTER * sizeof(unsigned short), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, used * sizeof(unsigned short), clusterIndices);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    lc.enabled = true;
+
+    frameStats.pointLights = (int)pointLights.size();
+    frameStats.lightsBinned = binnedLightCount;
+    frameStats.clusterLightRefs = used;
+    frameStats.clustersLit = lit;
+    frameStats.maxClusterLights = maxLights;
+    for (int slice = 0; slice < CLUSTER_SLICES; slice++) frameStats.lightsDropped += sliceDroppedLights[slice];
+    frameStats.clustersFull = full;
+    if (frameStats.lightsDropped > 0 && !warnedFullClusters) {
+        std::cerr << "Point lights: " << full << " clusters are full (" << MAX_LIGHTS_PER_CLUSTER
+            << " lights each); lights past that are dropped, see [P]" << std::endl;
+        warnedFullClusters = true;
+    }
+    frameStats.lightBinMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// --- Scene Submission ---
+// The scene code draws through these calls, which mirror the fixed-function
+// matrix stack but keep the matrices on the CPU and hand cached meshes to
+// whichever renderer is active.
+
+enum { PRIM_CUBE, PRIM_SPHERE, PRIM_CONE, PRIM_CYLINDER };
+
+struct Primitive {
+    int type;
+    int slices;
+    int stacks;
+    float param;
+    int mesh;
+};
+
+const int MODEL_STACK_DEPTH = 32;
+float modelStack[MODEL_STACK_DEPTH][16];
+int modelStackTop = 0;
+float currentColor[3] = { 1.0f, 1.0f, 1.0f };
+bool sceneHighlight = false; // Tints every colour set while on (selected objects)
+std::vector<Primitive> primitiveCache;
+
+// Uploads a finished (or changed) mesh to the active renderer
+void commitMesh(int id) {
+    renderer->uploadMesh(id);
+}
+
+// Builds each distinct primitive once and reuses it for every object after that
+int getPrimitive(int type, int slices, int stacks, float param) {
+    for (size_t i = 0; i < primitiveCache.size(); i++) {
+        const Primitive& p = primitiveCache[i];
+        if (p.type == type && p.slices == slices && p.stacks == stacks && p.param == param) return p.mesh;
+    }
+
+    int id = createMesh(false);
+    Mesh& m = meshes[id];
+    if (type == PRIM_CUBE) buildCube(m);
+    else if (type == PRIM_SPHERE) buildSphere(m, slices, stacks);
+    else if (type == PRIM_CONE) buildCone(m, slices, stacks);
+    else buildCylinder(m, slices, stacks, param);
+    commitMesh(id);
+
+    Primitive p = { type, slices, stacks, param, id };
+    primitiveCache.push_back(p);
+    return id;
+}
+
+void sceneLoadIdentity() {
+    modelStackTop = 0;
+    mat4Identity(modelStack[0]);
+}
+
+void scenePushMatrix() {
+    std::copy(modelStack[modelStackTop], modelStack[modelStackTop] + 16, modelStack[modelStackTop + 1]);
+    modelStackTop++;
+}
+
+void scenePopMatrix() {
+    modelStackTop--;
+}
+
+void sceneTranslatef(float x, float y, float z) { mat4Translate(modelStack[modelStackTop], x, y, z); }
+void sceneRotatef(float angle, float x, float y, float z) { mat4Rotate(modelStack[modelStackTop], angle, x, y, z); }
+void sceneScalef(float x, float y, float z) { mat4Scale(modelStack[modelStackTop], x, y, z); }
+
+void sceneColor3f(float r, float g, float b) {
+    currentColor[0] = r;
+    currentColor[1] = g;
+    currentColor[2] = b;
+    if (sceneHighlight) {
+        float c[3] = { r, g, b };
+        float highlight[3] = { 1.0f, 0.8f, 0.1f };
+        mixColor(currentColor, c, highlight, 0.6f);
+    }
+}
+
+void sceneColor3fv(const float* c) { sceneColor3f(c[0], c[1], c[2]); }
+
+void sceneDrawMesh(int id) {
+    float modelView[16];
+    mat4Multiply(modelView, viewMatrix, modelStack[modelStackTop]);
+    renderer->drawMesh(id, modelView, currentColor);
+    frameStats.drawCalls++;
+    frameStats.triangles += (int)meshes[id].indices.size() / 3;
+}
+
+void sceneSolidCube(float size) {
+    scenePushMatrix();
+    sceneScalef(size, size, size);
+    sceneDrawMesh(getPrimitive(PRIM_CUBE, 0, 0, 0.0f));
+    scenePopMatrix();
+}
+
+void sceneSolidSphere(float radius, int slices, int stacks) {
+    scenePushMatrix();
+    sceneScalef(radius, radius, radius);
+    sceneDrawMesh(getPrimitive(PRIM_SPHERE, slices, stacks, 0.0f));
+    scenePopMatrix();
+}
+
+void sceneSolidCone(float base, float height, int slices, int stacks) {
+    scenePushMatrix();
+    sceneScalef(base, base, height);
+    sceneDrawMesh(getPrimitive(PRIM_CONE, slices, stacks, 0.0f));
+    scenePopMatrix();
+}
+
+void sceneCylinder(float baseRadius, float topRadius, float height, int slices, int stacks) {
+    scenePushMatrix();
+    sceneScalef(baseRadius, baseRadius, height);
+    sceneDrawMesh(getPrimitive(PRIM_CYLINDER, slices, stacks, topRadius / baseRadius));
+    scenePopMatrix();
+}
+
+void drawBox(float width, float height, float depth) {
+    scenePushMatrix();
+    sceneScalef(width, height, depth);
+    sceneSolidCube(1.0f);
+    scenePopMatrix();
+}
+
+void drawCylinder(float baseRadius, float topRadius, float height) {
+    sceneCylinder(baseRadius, topRadius, height, 20, 5);
+}
+
+// --- Scene Layout ---
+
+float treePositions[NUM_TREES][2] = {
+    // Original trees
+    { -70.0f, -40.0f }, { -50.0f, -80.0f }, { -80.0f, -120.0f }, { 60.0f, -60.0f },
+    { 80.0f, -100.0f }, { 40.0f, -130.0f }, { 20.0f, -110.0f }, { -20.0f, -140.0f },
+    // New trees
+    { -30.0f, -20.0f }, { -10.0f, -45.0f }, { 10.0f, -30.0f }, { 30.0f, -50.0f },
+    { 50.0f, -25.0f }, { -60.0f, -60.0f }, { -40.0f, -100.0f }, { 0.0f, -80.0f },
+    { 70.0f, -80.0f }, { -90.0f, -30.0f }, { 90.0f, -40.0f }, { -15.0f, -70.0f },
+    { 15.0f, -90.0f }
+};
+
+// Start X, Y, Z, scale of the original clouds (X drifts with cloudOffset)
+float cloudLayout[NUM_CLOUDS][4] = {
+    { -40.0f, 35.0f, -20.0f, 1.2f },
+    { 10.0f, 38.0f, -25.0f, 1.0f },
+    { -10.0f, 32.0f, -15.0f, 1.5f },
+    { -65.0f, 36.0f, -30.0f, 1.3f },
+    { 50.0f, 40.0f, -10.0f, 0.9f }, // New
+    { -25.0f, 30.0f, -5.0f, 1.1f }  // New
+};
+
+// X, Z, scale, blade angle offset
+float windmillLayout[NUM_WINDMILLS][4] = {
+    // Left Cluster
+    { -55.0f, -10.0f, 0.9f, 20.0f }, // New Far Left
+    { -40.0f, 0.0f, 1.2f, 0.0f },    // Original
+    { -25.0f, -15.0f, 1.0f, 45.0f }, // Original
+    { -10.0f, 5.0f, 0.8f, 90.0f },   // Original
+    // Middle/Back Cluster
+    { -30.0f, 10.0f, 0.7f, 130.0f }, // New Back Middle
+    { -15.0f, -20.0f, 1.1f, 60.0f }  // New Front Middle
+};
+
+// X, Y, Z offset from the range centre (0, -5, -150), base radius, height
+float mountainPeaks[NUM_MOUNTAINS][5] = {
+    { 10.0f, 0.0f, 0.0f, 30.0f, 45.0f },   // Main central peak
+    { 45.0f, -5.0f, 5.0f, 25.0f, 35.0f },  // Right peak
+    { -30.0f, -5.0f, 5.0f, 28.0f, 40.0f }, // Left peak
+    { -60.0f, -8.0f, 0.0f, 20.0f, 30.0f }  // Far Left filler
+};
+
+// --- Occlusion Culling ---
+// The mountains and ground planes are rasterised on the CPU into a coarse depth
+// buffer each frame. Trees, the cloud band, sun and moon test their bounding
+// boxes against it before drawing. Whatever survives is wrapped in a GPU occlusion query whose
+// result is only picked up a frame later, once it is ready, so we never stall.
+
+const int OCC_WIDTH = 128;
+const int OCC_HEIGHT = 96;
+const float OCC_NEAR_W = 0.1f; // Clip-space w of the near plane
+
+enum {
+    OCC_SUN = 0,
+    OCC_MOON,
+    OCC_CLOUDS, // The whole band at once; puffs are not tested one by one
+    OCC_TREE_FIRST,
+    OCC_COUNT = OCC_TREE_FIRST + NUM_TREES
+};
+
+struct Occludee {
+    GLuint query;
+    bool queryPending;
+    bool gpuVisible;
+};
+
+float occDepth[OCC_WIDTH * OCC_HEIGHT];
+std::vector<float> occluderTriangles; // World-space xyz, 9 floats per triangle
+Occludee occludees[OCC_COUNT];
+int activeOccludee = -1;
+bool occlusionEnabled = true; // Toggled with [O]
+bool gpuQueriesSupported = false;
+
+void addOccluderTriangle(const float* a, const float* b, const float* c) {
+    occluderTriangles.insert(occluderTriangles.end(), a, a + 3);
+    occluderTriangles.insert(occluderTriangles.end(), b, b + 3);
+    occluderTriangles.insert(occluderTriangles.end(), c, c + 3);
+}
+
+void addOccluderQuad(float x0, float x1, float y, float z0, float z1) {
+    float a[] = { x0, y, z0 }, b[] = { x1, y, z0 }, c[] = { x1, y, z1 }, d[] = { x0, y, z1 };
+    addOccluderTriangle(a, b, c);
+    addOccluderTriangle(a, c, d);
+}
+
+void initOcclusion() {
+    // Mountain cones. The base polygon is shrunk to the inradius of the 10 slice
+    // cone GLUT draws, so the occluder always stays inside the visible mountain.
+    const int slices = 10;
+    float inset = cos(PI / slices);
+    for (int m = 0; m < NUM_MOUNTAINS; m++) {
+        float cx = mountainPeaks[m][0];
+        float cy = mountainPeaks[m][1] - 5.0f;
+        float cz = mountainPeaks[m][2] - 150.0f;
+        float r = mountainPeaks[m][3] * inset;
+        float apex[] = { cx, cy + mountainPeaks[m][4], cz };
+        for (int i = 0; i < slices; i++) {
+            float a0 = 2.0f * PI * i / slices;
+            float a1 = 2.0f * PI * (i + 1) / slices;
+            float x0 = cx + r * cos(a0), z0 = cz + r * sin(a0);
+            float x1 = cx + r * cos(a1), z1 = cz + r * sin(a1);
+            float p0[] = { x0, cy, z0 };
+            float p1[] = { x1, cy, z1 };
+            addOccluderTriangle(p0, p1, apex);
+        }
+    }
+
+    // Forest and sand planes (water is left out, its surface moves)
+    addOccluderQuad(-100.0f, 100.0f, -5.0f, -150.0f, -20.0f);
+    addOccluderQuad(-100.0f, 100.0f, -5.0f, -20.0f, 30.0f);
+
+    gpuQueriesSupported = GLEW_VERSION_1_5 || GLEW_ARB_occlusion_query;
+    for (int i = 0; i < OCC_COUNT; i++) {
+        occludees[i].query = 0;
+        occludees[i].queryPending = false;
+        occludees[i].gpuVisible = true;
+        if (gpuQueriesSupported) glGenQueries(1, &occludees[i].query);
+    }
+}
+
+// Clip-space vertex -> occlusion buffer coordinates (x, y in pixels, z in 0..1)
+void clipToOcclusionBuffer(const float* clip, float* out) {
+    out[0] = (clip[0] / clip[3] * 0.5f + 0.5f) * OCC_WIDTH;
+    out[1] = (clip[1] / clip[3] * 0.5f + 0.5f) * OCC_HEIGHT;
+    out[2] = clip[2] / clip[3] * 0.5f + 0.5f;
+}
+
+float edgeFunction(const float* a, const float* b, float px, float py) {
+    return (b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0]);
+}
+
+// Keeps the nearest depth of every pixel whose centre the triangle covers
+void rasterizeOccluderTriangle(const float* a, const float* b, const float* c) {
+    float area = edgeFunction(a, b, c[0], c[1]);
+    if (fabs(area) < 1e-6f) return;
+
+    int minX = std::max(0, (int)floor(std::min({ a[0], b[0], c[0] })));
+    int maxX = std::min(OCC_WIDTH - 1, (int)ceil(std::max({ a[0], b[0], c[0] })));
+    int minY = std::max(0, (int)floor(std::min({ a[1], b[1], c[1] })));
+    int maxY = std::min(OCC_HEIGHT - 1, (int)ceil(std::max({ a[1], b[1], c[1] })));
+
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f;
+            float l0 = edgeFunction(b, c, px, py) / area;
+            float l1 = edgeFunction(c, a, px, py) / area;
+            float l2 = edgeFunction(a, b, px, py) / area;
+            if (l0 < 0.0f || l1 < 0.0f || l2 < 0.0f) continue;
+
+            float z = l0 * a[2] + l1 * b[2] + l2 * c[2];
+            float& d = occDepth[y * OCC_WIDTH + x];
+            if (z < d) d = z;
+        }
+    }
+}
+
+void rasterizeOccluders() {
+    std::fill(occDepth, occDepth + OCC_WIDTH * OCC_HEIGHT, 1.0f);
+
+    for (size_t t = 0; t + 9 <= occluderTriangles.size(); t += 9) {
+        float in[3][4];
+        for (int v = 0; v < 3; v++) transformPoint(viewProjMatrix, &occluderTriangles[t + v * 3], in[v]);
+
+        // Clip against the near plane (w = OCC_NEAR_W), giving at most 4 vertices
+        float out[4][4];
+        int count = 0;
+        for (int v = 0; v < 3; v++) {
+            const float* cur = in[v];
+            const float* next = in[(v + 1) % 3];
+            bool curInside = cur[3] >= OCC_NEAR_W;
+            bool nextInside = next[3] >= OCC_NEAR_W;
+            if (curInside) std::copy(cur, cur + 4, out[count++]);
+            if (curInside != nextInside) {
+                float s = (OCC_NEAR_W - cur[3]) / (next[3] - cur[3]);
+                for (int k = 0; k < 4; k++) out[count][k] = cur[k] + (next[k] - cur[k]) * s;
+                count++;
+            }
+        }
+        if (count < 3) continue;
+
+        float screen[4][3];
+        for (int v = 0; v < count; v++) clipToOcclusionBuffer(out[v], screen[v]);
+        for (int v = 1; v + 1 < count; v++) rasterizeOccluderTriangle(screen[0], screen[v], screen[v + 1]);
+    }
+}
+
+// True only if every pixel the box could touch is already covered by something nearer
+bool isOccludedOnCpu(const float* bmin, const float* bmax) {
+    float minX = 1e9f, minY = 1e9f, maxX = -1e9f, maxY = -1e9f;
+    float nearest = 1.0f;
+    for (int i = 0; i < 8; i++) {
+        float corner[] = { (i & 1) ? bmax[0] : bmin[0], (i & 2) ? bmax[1] : bmin[1], (i & 4) ? bmax[2] : bmin[2] };
+        float clip[4], screen[3];
+        transformPoint(viewProjMatrix, corner, clip);
+        if (clip[3] < OCC_NEAR_W) return false; // Crosses the near plane
+        clipToOcclusionBuffer(clip, screen);
+        minX = std::min(minX, screen[0]); maxX = std::max(maxX, screen[0]);
+        minY = std::min(minY, screen[1]); maxY = std::max(maxY, screen[1]);
+        nearest = std::min(nearest, screen[2]);
+    }
+
+    // Grow by a pixel: occluder pixels are only sampled at their centres
+    int x0 = std::max(0, (int)floor(minX) - 1);
+    int x1 = std::min(OCC_WIDTH - 1, (int)ceil(maxX) + 1);
+    int y0 = std::max(0, (int)floor(minY) - 1);
+    int y1 = std::min(OCC_HEIGHT - 1, (int)ceil(maxY) + 1);
+    if (x0 > x1 || y0 > y1) return false; // Off screen, leave it to GL clipping
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (occDepth[y * OCC_WIDTH + x] >= nearest) return false;
+        }
+    }
+    return true;
+}
+
+// Box with colour and depth writes off, used to query objects hidden last frame
+void drawOcclusionProxy(const float* bmin, const float* bmax) {
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    scenePushMatrix();
+    sceneTranslatef((bmin[0] + bmax[0]) * 0.5f, (bmin[1] + bmax[1]) * 0.5f, (bmin[2] + bmax[2]) * 0.5f);
+    drawBox(bmax[0] - bmin[0], bmax[1] - bmin[1], bmax[2] - bmin[2]);
+    scenePopMatrix();
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// Returns false if the object should be skipped this frame.
+// When it returns true, call endOcclusionTest() right after drawing the object.
+bool beginOcclusionTest(int id, const float* bmin, const float* bmax) {
+    Occludee& o = occludees[id];
+    frameStats.occlusionTested++;
+    activeOccludee = -1;
+
+    if (!occlusionEnabled) {
+        o.gpuVisible = true;
+        o.queryPending = false;
+        return true;
+    }
+    if (isOccludedOnCpu(bmin, bmax)) {
+        frameStats.cpuOccluded++;
+        // Draw straight away once it comes out again; drop any stale proxy result
+        o.gpuVisible = true;
+        o.queryPending = false;
+        return false;
+    }
+    if (!gpuQueriesSupported) return true;
+
+    // Pick up last frame's answer, but only if the GPU already has it
+    if (o.queryPending) {
+        GLuint ready = 0;
+        glGetQueryObjectuiv(o.query, GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (ready) {
+            GLuint samples = 0;
+            glGetQueryObjectuiv(o.query, GL_QUERY_RESULT, &samples);
+            o.gpuVisible = samples > 0;
+            o.queryPending = false;
+        }
+    }
+
+    if (!o.gpuVisible) {
+        frameStats.gpuOccluded++;
+        if (!o.queryPending) {
+            glBeginQuery(GL_SAMPLES_PASSED, o.query);
+            drawOcclusionProxy(bmin, bmax);
+            glEndQuery(GL_SAMPLES_PASSED);
+            o.queryPending = true;
+        }
+        return false;
+    }
+
+    if (!o.queryPending) {
+        glBeginQuery(GL_SAMPLES_PASSED, o.query);
+        o.queryPending = true;
+        activeOccludee = id;
+    }
+    return true;
+}
+
+void endOcclusionTest() {
+    if (activeOccludee >= 0) glEndQuery(GL_SAMPLES_PASSED);
+    activeOccludee = -1;
+}
+
+// --- Voxel Text ---
+// Any string can be spelled in blocks. Each glyph is a 5 row bitmap ('#' is a
+// block); glyphs sit one empty column apart. A string is turned into a single
+// mesh: faces between two blocks are dropped and the remaining faces are
+// merged into as few quads as possible (greedy meshing). Meshes are cached by
+// string, so a label costs one draw call after its first frame.
+
+const int GLYPH_ROWS = 5;
+
+struct Glyph {
+    char ch;
+    const char* rows[GLYPH_ROWS]; // Top row first, all rows the same width
+};
+
+const Glyph GLYPHS[] = {
+    { 'A', { "###", "#.#", "###", "#.#", "#.#" } },
+    { 'B', { "##.", "#.#", "##.", "#.#", "##." } },
+    { 'C', { "###", "#..", "#..", "#..", "###" } },
+    { 'D', { "##.", "#.#", "#.#", "#.#", "##." } },
+    { 'E', { "###", "#..", "###", "#..", "###" } },
+    { 'F', { "###", "#..", "###", "#..", "#.." } },
+    { 'G', { "###", "#..", "#.#", "#.#", "###" } },
+    { 'H', { "#.#", "#.#", "###", "#.#", "#.#" } },
+    { 'I', { "#", "#", "#", "#", "#" } },
+    { 'J', { "..#", "..#", "..#", "#.#", "###" } },
+    { 'K', { "#.#", "#.#", "##.", "#.#", "#.#" } },
+    { 'L', { "#..", "#..", "#..", "#..", "###" } },
+    { 'M', { "#.#", "###", "###", "#.#", "#.#" } },
+    { 'N', { "###", "#.#", "#.#", "#.#", "#.#" } },
+    { 'O', { "###", "#.#", "#.#", "#.#", "###" } },
+    { 'P', { "###", "#.#", "###", "#..", "#.." } },
+    { 'Q', { "###", "#.#", "#.#", "###", "..#" } },
+    { 'R', { "###", "#.#", "##.", "#.#", "#.#" } },
+    { 'S', { "###", "#..", "###", "..#", "###" } },
+    { 'T', { "###", ".#.", ".#.", ".#.", ".#." } },
+    { 'U', { "#.#", "#.#", "#.#", "#.#", "###" } },
+    { 'V', { "#.#", "#.#", "#.#", "#.#", ".#." } },
+    { 'W', { "#.#", "#.#", "###", "###", "#.#" } },
+    { 'X', { "#.#", "#.#", ".#.", "#.#", "#.#" } },
+    { 'Y', { "#.#", "#.#", ".#.", ".#.", ".#." } },
+    { 'Z', { "###", "..#", ".#.", "#..", "###" } },
+    { '0', { "###", "#.#", "#.#", "#.#", "###" } },
+    { '1', { ".#.", "##.", ".#.", ".#.", "###" } },
+    { '2', { "###", "..#", "###", "#..", "###" } },
+    { '3', { "###", "..#", "###", "..#", "###" } },
+    { '4', { "#.#", "#.#", "###", "..#", "..#" } },
+    { '5', { "###", "#..", "###", "..#", "###" } },
+    { '6', { "###", "#..", "###", "#.#", "###" } },
+    { '7', { "###", "..#", "..#", "..#", "..#" } },
+    { '8', { "###", "#.#", "###", "#.#", "###" } },
+    { '9', { "###", "#.#", "###", "..#", "###" } },
+    { ' ', { "..", "..", "..", "..", ".." } },
+    { '-', { "...", "...", "###", "...", "..." } },
+    { '.', { ".", ".", ".", ".", "#" } },
+    { ':', { ".", "#", ".", "#", "." } },
+    { '!', { "#", "#", "#", ".", "#" } },
+    { '?', { "###", "..#", ".##", "...", ".#." } }
+};
+
+// Unknown characters fall back to '?'
+const Glyph& findGlyph(char c) {
+    c = (char)toupper((unsigned char)c);
+    const Glyph* fallback = nullptr;
+    for (const Glyph& g : GLYPHS) {
+        if (g.ch == c) return g;
+        if (g.ch == '?') fallback = &g;
+    }
+    return *fallback;
+}
+
+int glyphWidth(const Glyph& g) {
+    return (int)strlen(g.rows[0]);
+}
+
+// Blocks of a string laid out on a grid: columns left to right, rows bottom up
+struct VoxelGrid {
+    int width;
+    std::vector<unsigned char> cells; // width * GLYPH_ROWS
+    std::vector<int> glyphStart;      // First column of every character
+};
+
+void layoutText(const std::string& text, VoxelGrid& grid) {
+    grid.width = 0;
+    grid.glyphStart.clear();
+    for (size_t i = 0; i < text.size(); i++) {
+        grid.glyphStart.push_back(grid.width);
+        grid.width += glyphWidth(findGlyph(text[i])) + (i + 1 < text.size() ? 1 : 0);
+    }
+    grid.cells.assign(grid.width * GLYPH_ROWS, 0);
+    for (size_t i = 0; i < text.size(); i++) {
+        const Glyph& g = findGlyph(text[i]);
+        for (int row = 0; row < GLYPH_ROWS; row++) {
+            for (int col = 0; g.rows[row][col] != '\0'; col++) {
+                if (g.rows[row][col] == '#') grid.cells[(GLYPH_ROWS - 1 - row) * grid.width + grid.glyphStart[i] + col] = 1;
+            }
+        }
+    }
+}
+
+// Greedy mesher over a width x 5 x 1 block grid. Block (x, y) fills
+// [x - 0.5, x + 0.5] x [y - 0.5, y + 0.5] x [-0.5, 0.5], the same space the
+// unit cubes of the old per-block text did.
+void buildVoxelMesh(const VoxelGrid& grid, Mesh& m) {
+    const int dims[3] = { grid.width, GLYPH_ROWS, 1 };
+    std::vector<int> mask;
+
+    for (int d = 0; d < 3; d++) {
+        int u = (d + 1) % 3;
+        int v = (d + 2) % 3;
+        int x[3] = { 0, 0, 0 };
+        int q[3] = { 0, 0, 0 };
+        q[d] = 1;
+        mask.assign(dims[u] * dims[v], 0);
+
+        for (x[d] = -1; x[d] < dims[d]; ) {
+            // Which faces on the plane between slice x[d] and x[d] + 1 are exposed:
+            // +1 faces along +d (block behind), -1 faces along -d (block in front)
+            int n = 0;
+            for (x[v] = 0; x[v] < dims[v]; x[v]++) {
+                for (x[u] = 0; x[u] < dims[u]; x[u]++, n++) {
+                    bool a = x[d] >= 0 && grid.cells[x[1] * grid.width + x[0]];
+                    bool b = x[d] < dims[d] - 1 && grid.cells[(x[1] + q[1]) * grid.width + x[0] + q[0]];
+                    mask[n] = (a == b) ? 0 : (a ? 1 : -1);
+                }
+            }
+            x[d]++;
+
+            // Grow each exposed face into the largest rectangle of matching faces
+            n = 0;
+            for (int j = 0; j < dims[v]; j++) {
+                for (int i = 0; i < dims[u]; ) {
+                    int face = mask[n];
+                    if (face == 0) { i++; n++; continue; }
+
+                    int w = 1;
+                    while (i + w < dims[u] && mask[n + w] == face) w++;
+                    int h = 1;
+                    for (; j + h < dims[v]; h++) {
+                        bool rowMatches = true;
+                        for (int k = 0; k < w; k++) {
+                            if (mask[n + k + h * dims[u]] != face) { rowMatches = false; break; }
+                        }
+                        if (!rowMatches) break;
+                    }
+
+                    float base[3];
+                    base[d] = (float)x[d];
+                    base[u] = (float)i;
+                    base[v] = (float)j;
+                    float du[3] = { 0, 0, 0 }, dv[3] = { 0, 0, 0 };
+                    du[u] = (float)w;
+                    dv[v] = (float)h;
+                    float normal[3] = { 0, 0, 0 };
+                    normal[d] = (float)face;
+
+                    unsigned int first = (unsigned int)m.vertices.size();
+                    for (int c = 0; c < 4; c++) {
+                        float su = (c == 1 || c == 2) ? 1.0f : 0.0f;
+                        float sv = (c >= 2) ? 1.0f : 0.0f;
+                        addVertex(m, base[0] + du[0] * su + dv[0] * sv - 0.5f,
+                            base[1] + du[1] * su + dv[1] * sv - 0.5f,
+                            base[2] + du[2] * su + dv[2] * sv - 0.5f,
+                            normal[0], normal[1], normal[2]);
+                    }
+                    // du x dv points along +d, so flip the winding for -d faces
+                    if (face > 0) {
+                        addTriangle(m, first, first + 1, first + 2);
+                        addTriangle(m, first, first + 2, first + 3);
+                    }
+                    else {
+                        addTriangle(m, first, first + 2, first + 1);
+                        addTriangle(m, first, first + 3, first + 2);
+                    }
+
+                    for (int l = 0; l < h; l++) {
+                        for (int k = 0; k < w; k++) mask[n + k + l * dims[u]] = 0;
+                    }
+                    i += w;
+                    n += w;
+                }
+            }
+        }
+    }
+}
+
+std::map<std::string, int, std::less<> > textMeshCache;
+
+// Finds (or builds, the first time a string is seen) the mesh for some text
+int getTextMesh(std::string_view text) {
+    auto it = textMeshCache.find(text);
+    if (it != textMeshCache.end()) return it->second;
+
+    std::string key(text);
+    VoxelGrid grid;
+    layoutText(key, grid);
+    int id = createMesh(false);
+    buildVoxelMesh(grid, meshes[id]);
+    commitMesh(id);
+
+    textMeshCount++;
+    textMeshBlocks += std::count(grid.cells.begin(), grid.cells.end(), 1);
+    textMeshTriangles += meshes[id].indices.size() / 3;
+
+    textMeshCache[key] = id;
+    return id;
+}
+
+// Draws text with its bottom-left block centred on the current origin, one unit per block
+void drawVoxelText(std::string_view text) {
+    sceneDrawMesh(getTextMesh(text));
+}
+
+// --- Particle Clouds ---
+// The sky is a single set of soft sprites ("puffs") handed to the renderer once;
+// each backend drifts every puff along X with cloudOffset and wraps it around
+// (see Renderer::drawPuffs). Sprites are alpha blended and need a back-to-front
+// order; that sort runs on a worker thread when the camera has moved, when the
+// drift has carried the band CLOUD_RESORT_DRIFT along, or when a puff is about
+// to wrap to the far end. The finished order is passed to the renderer.
+
+const float CLOUD_RESORT_DRIFT = 1.0f; // About a second of drift
+
+std::vector<Puff> puffs;
+float cloudBandMin[3], cloudBandMax[3]; // Every puff at every offset
+std::vector<unsigned int> cloudOrder; // Back to front, newest finished sort (main thread)
+bool cloudOrderChanged = false;       // Not handed to the renderer yet
+
+// Worker-thread sort state; everything below the mutex is guarded by it
+std::thread cloudSortThread;
+std::mutex cloudSortMutex;
+std::condition_variable cloudSortWake;
+bool cloudSortQuit = false;
+bool cloudSortRequested = false;
+bool cloudSortReady = false;
+float cloudSortView[16];
+float cloudSortOffset = 0.0f;
+std::vector<unsigned int> cloudSortResult;
+float cloudSortResultOffset = 0.0f; // cloudOffset the result was sorted at
+float cloudSortWrapDrift = 0.0f;    // Drift from there until the first puff wraps
+float lastCloudSortMs = 0.0f;
+int cloudSortCount = 0;
+
+// Camera and drift the current order was requested for (main thread only)
+float sortedRotX = 1e9f, sortedRotY = 1e9f, sortedZoom = 1e9f;
+float orderOffset = 0.0f;
+float orderWrapDrift = 0.0f;
+bool cloudSortInFlight = false;
+
+float randomRange(std::mt19937& rng, float lo, float hi) {
+    return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
 
-void drawBox(float width, float height, float depth) {
-    glPushMatrix();
-    glScalef(width, height, depth);
-    glutSolidCube(1.0f);
-    glPopMatrix();
+// Fills a sphere of the old three-sphere cloud shape with puffs
+void addPuffBall(std::mt19937& rng, float x, float y, float z, float radius, int count) {
+    for (int i = 0; i < count; i++) {
+        float dx, dy, dz;
+        do {
+            dx = randomRange(rng, -1.0f, 1.0f);
+            dy = randomRange(rng, -1.0f, 1.0f);
+            dz = randomRange(rng, -1.0f, 1.0f);
+        } while (dx * dx + dy * dy + dz * dz > 1.0f);
+        Puff p = { { x + dx * radius * 0.6f, y + dy * radius * 0.6f, z + dz * radius * 0.6f },
+            radius * randomRange(rng, 0.9f, 1.3f), randomRange(rng, 0.9f, 1.0f) };
+        puffs.push_back(p);
+    }
 }
 
-void drawCylinder(float baseRadius, float topRadius, float height) {
-    GLUquadric* quad = gluNewQuadric();
-    gluCylinder(quad, baseRadius, topRadius, height, 20, 5);
-    gluDeleteQuadric(quad);
+// Same silhouette drawCloud used to build from three spheres
+void addCloud(std::mt19937& rng, float x, float y, float z, float scale, int puffsPerBall) {
+    addPuffBall(rng, x, y, z, 3.0f * scale, puffsPerBall);
+    addPuffBall(rng, x + 3.5f * scale, y, z, 2.5f * scale, puffsPerBall);
+    addPuffBall(rng, x + 2.0f * scale, y + 2.0f * scale, z + 0.5f * scale, 2.5f * scale, puffsPerBall);
 }
 
-// Linear Interpolation for colors
-void mixColor(float* output, float* c1, float* c2, float t) {
-    output[0] = c1[0] * (1.0f - t) + c2[0] * t;
-    output[1] = c1[1] * (1.0f - t) + c2[1] * t;
-    output[2] = c1[2] * (1.0f - t) + c2[2] * t;
+void cloudSortWorker() {
+    std::vector<float> depth(puffs.size());
+    std::vector<unsigned int> order(puffs.size());
+    float view[16];
+    float offset;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(cloudSortMutex);
+            cloudSortWake.wait(lock, [] { return cloudSortQuit || cloudSortRequested; });
+            if (cloudSortQuit) return;
+            std::copy(cloudSortView, cloudSortView + 16, view);
+            offset = cloudSortOffset;
+            cloudSortRequested = false;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        float wrapDrift = CLOUD_WRAP_WIDTH;
+        for (size_t i = 0; i < puffs.size(); i++) {
+            const float* p = puffs[i].pos;
+            float x = wrapCloudX(p[0], offset);
+            wrapDrift = std::min(wrapDrift, CLOUD_WRAP_WIDTH * 0.5f - x);
+            depth[i] = view[2] * x + view[6] * p[1] + view[10] * p[2] + view[14]; // Eye-space Z
+            order[i] = (unsigned int)i;
+        }
+        // Most negative eye Z is farthest away: draw those first
+        std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return depth[a] < depth[b]; });
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(cloudSortMutex);
+        cloudSortResult.swap(order); // 'order' gets the old buffer back, nothing is reallocated
+        cloudSortResultOffset = offset;
+        cloudSortWrapDrift = wrapDrift;
+        cloudSortReady = true;
+        lastCloudSortMs = ms;
+        cloudSortCount++;
+    }
+}
+
+void shutdownCloudParticles() {
+    if (!cloudSortThread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(cloudSortMutex);
+        cloudSortQuit = true;
+    }
+    cloudSortWake.notify_one();
+    cloudSortThread.join();
+}
+
+void initCloudParticles(int puffCount) {
+    std::mt19937 rng(1234);
+
+    // The six original clouds first, then random ones across the sky band
+    for (int i = 0; i < NUM_CLOUDS && (int)puffs.size() < puffCount; i++) {
+        addCloud(rng, cloudLayout[i][0], cloudLayout[i][1], cloudLayout[i][2], cloudLayout[i][3], 12);
+    }
+    while ((int)puffs.size() < puffCount) {
+        float x = randomRange(rng, -CLOUD_WRAP_WIDTH * 0.5f, CLOUD_WRAP_WIDTH * 0.5f);
+        addCloud(rng, x, randomRange(rng, 28.0f, 50.0f), randomRange(rng, -140.0f, 40.0f),
+            randomRange(rng, 0.8f, 1.6f), 12);
+    }
+    puffs.resize(puffCount);
+    renderer->uploadPuffs(puffs);
+
+    // Drift wraps X within the band; Y and Z never change
+    for (int k = 0; k < 3; k++) {
+        cloudBandMin[k] = 1e9f;
+        cloudBandMax[k] = -1e9f;
+    }
+    for (size_t i = 0; i < puffs.size(); i++) {
+        float r = puffs[i].size * 0.5f;
+        for (int k = 1; k < 3; k++) {
+            cloudBandMin[k] = std::min(cloudBandMin[k], puffs[i].pos[k] - r);
+            cloudBandMax[k] = std::max(cloudBandMax[k], puffs[i].pos[k] + r);
+        }
+        cloudBandMin[0] = std::min(cloudBandMin[0], -CLOUD_WRAP_WIDTH * 0.5f - r);
+        cloudBandMax[0] = std::max(cloudBandMax[0], CLOUD_WRAP_WIDTH * 0.5f + r);
+    }
+
+    // Unsorted to begin with; the first sort replaces it
+    cloudOrder.resize(puffs.size());
+    for (size_t i = 0; i < puffs.size(); i++) cloudOrder[i] = (unsigned int)i;
+    cloudSortResult = cloudOrder;
+
+    cloudSortThread = std::thread(cloudSortWorker);
+    atexit(shutdownCloudParticles); // GLUT leaves its main loop through exit()
+}
+
+// Asks for a new order when the camera or the drift calls for one, and picks one
+// up when it is ready. Returns true if cloudOrder changed.
+bool updateCloudOrder() {
+    std::lock_guard<std::mutex> lock(cloudSortMutex);
+    bool changed = false;
+    if (cloudSortReady) {
+        cloudOrder.swap(cloudSortResult); // The worker gets the old buffer back
+        orderOffset = cloudSortResultOffset;
+        orderWrapDrift = cloudSortWrapDrift;
+        cloudSortReady = false;
+        cloudSortInFlight = cloudSortRequested;
+        changed = true;
+    }
+
+    // cloudOffset itself jumps back by the wrap width, which moves nothing
+    float drift = cloudOffset - orderOffset;
+    if (drift < 0.0f) drift += CLOUD_WRAP_WIDTH;
+    bool cameraMoved = rotX != sortedRotX || rotY != sortedRotY || zoom != sortedZoom;
+    bool drifted = !cloudSortInFlight && drift >= std::min(CLOUD_RESORT_DRIFT, orderWrapDrift);
+    if (cameraMoved || drifted) {
+        std::copy(viewMatrix, viewMatrix + 16, cloudSortView);
+        cloudSortOffset = cloudOffset;
+        cloudSortRequested = true; // Replaces any request the worker has not picked up yet
+        cloudSortInFlight = true;
+        sortedRotX = rotX;
+        sortedRotY = rotY;
+        sortedZoom = zoom;
+        cloudSortWake.notify_one();
+    }
+    frameStats.cloudSorts = cloudSortCount;
+    frameStats.cloudSortMs = lastCloudSortMs;
+    return changed;
+}
+
+// Draws every puff in one call; goes after the opaque scene since it blends
+void drawCloudParticles(const float* tint) {
+    if (updateCloudOrder()) cloudOrderChanged = true;
+    if (!beginOcclusionTest(OCC_CLOUDS, cloudBandMin, cloudBandMax)) return;
+    renderer->drawPuffs(cloudOrder, cloudOrderChanged, viewMatrix, cloudOffset, tint);
+    endOcclusionTest();
+    cloudOrderChanged = false;
+    frameStats.drawCalls++;
+    frameStats.cloudPuffs += (int)puffs.size();
+}
+
+// --- Picking ---
+// Clicks are resolved on the CPU. Every pickable part of the scene (tree trunk
+// and crown, windmill pole, hub and blades, each block of the sign) is a box
+// with its own transform, and the boxes' world bounds are kept in a bounding
+// volume hierarchy built with the surface area heuristic. A click casts a ray
+// from the camera through the cursor and walks the hierarchy, so nothing ever
+// waits on the GPU. Blades turn every tick; their boxes are updated in place
+// and the hierarchy is refit bottom up instead of rebuilt.
+
+enum PickKind { PICK_NONE, PICK_TREE, PICK_WINDMILL, PICK_LETTER };
+
+struct PickBox {
+    float worldMin[3], worldMax[3]; // Bounds kept in the hierarchy
+    float localMin[3], localMax[3]; // The box in its own space
+    float toLocal[16];              // World space -> box space
+    int kind;
+    int index;                      // Tree, windmill or sign character number
+};
+
+// Interior nodes (count 0) have their two children at first and first + 1;
+// leaves hold boxes order[first .. first + count)
+struct BvhNode {
+    float bmin[3], bmax[3];
+    int first;
+    int count;
+};
+
+struct Bvh {
+    std::vector<PickBox> boxes;
+    std::vector<int> order;
+    std::vector<BvhNode> nodes;
+};
+
+const int BVH_BINS = 16;
+const int BVH_LEAF_SIZE = 2;       // Nodes this small are never split
+const int BVH_MAX_DEPTH = 48;      // Also bounds the traversal stack
+const float BVH_TRAVERSAL_COST = 1.0f; // Relative to one box test
+
+Bvh sceneBvh;
+int bladeBoxFirst = 0;             // NUM_WINDMILLS * 3 blade boxes start here
+float refitWindmillAngle = 0.0f;   // windmillAngle the blade boxes were set for
+int selectedKind = PICK_NONE;
+int selectedIndex = -1;
+std::vector<int> signGlyphStart;   // First column of every sign character
+
+void setPickBox(PickBox& box, const float* model, const float* localMin, const float* localMax) {
+    std::copy(localMin, localMin + 3, box.localMin);
+    std::copy(localMax, localMax + 3, box.localMax);
+    mat4AffineInverse(box.toLocal, model);
+    for (int a = 0; a < 3; a++) {
+        box.worldMin[a] = 1e30f;
+        box.worldMax[a] = -1e30f;
+    }
+    for (int c = 0; c < 8; c++) {
+        float corner[3] = { (c & 1) ? localMax[0] : localMin[0], (c & 2) ? localMax[1] : localMin[1],
+            (c & 4) ? localMax[2] : localMin[2] };
+        float world[4];
+        transformPoint(model, corner, world);
+        for (int a = 0; a < 3; a++) {
+            box.worldMin[a] = std::min(box.worldMin[a], world[a]);
+            box.worldMax[a] = std::max(box.worldMax[a], world[a]);
+        }
+    }
+}
+
+void addPickBox(Bvh& bvh, const float* model, const float* localMin, const float* localMax, int kind, int index) {
+    PickBox box;
+    setPickBox(box, model, localMin, localMax);
+    box.kind = kind;
+    box.index = index;
+    bvh.boxes.push_back(box);
+}
+
+float boundsArea(const float* bmin, const float* bmax) {
+    float dx = bmax[0] - bmin[0], dy = bmax[1] - bmin[1], dz = bmax[2] - bmin[2];
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+void growBounds(float* bmin, float* bmax, const float* pmin, const float* pmax) {
+    for (int a = 0; a < 3; a++) {
+        bmin[a] = std::min(bmin[a], pmin[a]);
+        bmax[a] = std::max(bmax[a], pmax[a]);
+    }
+}
+
+void updateNodeBounds(Bvh& bvh, int nodeIndex) {
+    BvhNode& node = bvh.nodes[nodeIndex];
+    std::fill(node.bmin, node.bmin + 3, 1e30f);
+    std::fill(node.bmax, node.bmax + 3, -1e30f);
+    if (node.count == 0) {
+        for (int c = 0; c < 2; c++) growBounds(node.bmin, node.bmax, bvh.nodes[node.first + c].bmin, bvh.nodes[node.first + c].bmax);
+        return;
+    }
+    for (int i = node.first; i < node.first + node.count; i++) {
+        const PickBox& box = bvh.boxes[bvh.order[i]];
+        growBounds(node.bmin, node.bmax, box.worldMin, box.worldMax);
+    }
+}
+
+float boxCentroid(const PickBox& box, int axis) {
+    return 0.5f * (box.worldMin[axis] + box.worldMax[axis]);
+}
+
+// Splits a leaf where the surface area heuristic (binned box centroids) says
+// it pays off, then does the same for both halves
+void subdivideBvhNode(Bvh& bvh, int nodeIndex, int depth) {
+    updateNodeBounds(bvh, nodeIndex);
+    BvhNode node = bvh.nodes[nodeIndex];
+    if (node.count <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH) return;
+
+    float cmin[3] = { 1e30f, 1e30f, 1e30f }, cmax[3] = { -1e30f, -1e30f, -1e30f };
+    for (int i = node.first; i < node.first + node.count; i++) {
+        for (int a = 0; a < 3; a++) {
+            float c = boxCentroid(bvh.boxes[bvh.order[i]], a);
+            cmin[a] = std::min(cmin[a], c);
+            cmax[a] = std::max(cmax[a], c);
+        }
+    }
+
+    // Costs are scaled by the node's own area: leaf = N * A
+    float nodeArea = boundsArea(node.bmin, node.bmax);
+    float bestCost = node.count * nodeArea;
+    int bestAxis = -1, bestBin = 0;
+    for (int a = 0; a < 3; a++) {
+        float extent = cmax[a] - cmin[a];
+        if (extent <= 0.0f) continue;
+        int binCount[BVH_BINS] = {};
+        float binMin[BVH_BINS][3], binMax[BVH_BINS][3];
+        for (int b = 0; b < BVH_BINS; b++) {
+            std::fill(binMin[b], binMin[b] + 3, 1e30f);
+            std::fill(binMax[b], binMax[b] + 3, -1e30f);
+        }
+        float scale = BVH_BINS / extent;
+        for (int i = node.first; i < node.first + node.count; i++) {
+            const PickBox& box = bvh.boxes[bvh.order[i]];
+            int b = std::min(BVH_BINS - 1, (int)((boxCentroid(box, a) - cmin[a]) * scale));
+            binCount[b]++;
+            growBounds(binMin[b], binMax[b], box.worldMin, box.worldMax);
+        }
+
+        // Sweep from both ends; split b puts bins 0..b on the left
+        float leftArea[BVH_BINS - 1], rightArea[BVH_BINS - 1];
+        int leftCount[BVH_BINS - 1], rightCount[BVH_BINS - 1];
+        float lmin[3] = { 1e30f, 1e30f, 1e30f }, lmax[3] = { -1e30f, -1e30f, -1e30f };
+        float rmin[3] = { 1e30f, 1e30f, 1e30f }, rmax[3] = { -1e30f, -1e30f, -1e30f };
+        int lsum = 0, rsum = 0;
+        for (int b = 0; b < BVH_BINS - 1; b++) {
+            lsum += binCount[b];
+            if (binCount[b] > 0) growBounds(lmin, lmax, binMin[b], binMax[b]);
+            leftCount[b] = lsum;
+            leftArea[b] = lsum > 0 ? boundsArea(lmin, lmax) : 0.0f;
+            int r = BVH_BINS - 1 - b;
+            rsum += binCount[r];
+            if (binCount[r] > 0) growBounds(rmin, rmax, binMin[r], binMax[r]);
+            rightCount[r - 1] = rsum;
+            rightArea[r - 1] = rsum > 0 ? boundsArea(rmin, rmax) : 0.0f;
+        }
+        for (int b = 0; b < BVH_BINS - 1; b++) {
+            if (leftCount[b] == 0 || rightCount[b] == 0) continue;
+            float cost = BVH_TRAVERSAL_COST * nodeArea + leftCount[b] * leftArea[b] + rightCount[b] * rightArea[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = a;
+                bestBin = b;
+            }
+        }
+    }
+    if (bestAxis < 0) return; // Cheaper as a leaf
+
+    float scale = BVH_BINS / (cmax[bestAxis] - cmin[bestAxis]);
+    int* mid = std::partition(bvh.order.data() + node.first, bvh.order.data() + node.first + node.count, [&](int i) {
+        return std::min(BVH_BINS - 1, (int)((boxCentroid(bvh.boxes[i], bestAxis) - cmin[bestAxis]) * scale)) <= bestBin;
+    });
+    int leftCount = (int)(mid - bvh.order.data()) - node.first;
+
+    int left = (int)bvh.nodes.size();
+    BvhNode child = {};
+    child.first = node.first;
+    child.count = leftCount;
+    bvh.nodes.push_back(child);
+    child.first = node.first + leftCount;
+    child.count = node.count - leftCount;
+    bvh.nodes.push_back(child);
+    bvh.nodes[nodeIndex].first = left;
+    bvh.nodes[nodeIndex].count = 0;
+    subdivideBvhNode(bvh, left, depth + 1);
+    subdivideBvhNode(bvh, left + 1, depth + 1);
+}
+
+void buildBvh(Bvh& bvh) {
+    int count = (int)bvh.boxes.size();
+    bvh.order.resize(count);
+    for (int i = 0; i < count; i++) bvh.order[i] = i;
+    bvh.nodes.clear();
+    bvh.nodes.reserve(std::max(1, 2 * count - 1));
+    BvhNode root = {};
+    root.count = count;
+    bvh.nodes.push_back(root);
+    if (count > 0) subdivideBvhNode(bvh, 0, 0);
+}
+
+// Children always come after their parent, so one backwards pass is enough
+void refitBvh(Bvh& bvh) {
+    for (int i = (int)bvh.nodes.size() - 1; i >= 0; i--) updateNodeBounds(bvh, i);
+}
+
+// Slab test; tNear is where the ray enters the box
+bool rayHitsBounds(const float* origin, const float* invDir, const float* bmin, const float* bmax, float maxT, float& tNear) {
+    float t0 = 0.0f, t1 = maxT;
+    for (int a = 0; a < 3; a++) {
+        float ta = (bmin[a] - origin[a]) * invDir[a];
+        float tb = (bmax[a] - origin[a]) * invDir[a];
+        t0 = std::max(t0, std::min(ta, tb));
+        t1 = std::min(t1, std::max(ta, tb));
+    }
+    tNear = t0;
+    return t0 <= t1;
+}
+
+// Nearest box along origin + t * dir, or -1. t stays in world units because
+// the boxes' transforms are affine and dir is not renormalised.
+int raycastBvh(const Bvh& bvh, const float* origin, const float* dir, float& hitT, int& nodesVisited) {
+    hitT = 1e30f;
+    nodesVisited = 0;
+    if (bvh.boxes.empty()) return -1;
+    float invDir[3] = { 1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2] };
+    int hit = -1;
+    int stack[BVH_MAX_DEPTH + 2];
+    int top = 0;
+    float tNear;
+    if (!rayHitsBounds(origin, invDir, bvh.nodes[0].bmin, bvh.nodes[0].bmax, hitT, tNear)) return -1;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const BvhNode& node = bvh.nodes[stack[--top]];
+        nodesVisited++;
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                const PickBox& box = bvh.boxes[bvh.order[i]];
+                if (!rayHitsBounds(origin, invDir, box.worldMin, box.worldMax, hitT, tNear)) continue;
+                float localOrigin[4], localDir[3];
+                transformPoint(box.toLocal, origin, localOrigin);
+                transformDirection(box.toLocal, dir, localDir);
+                float localInvDir[3] = { 1.0f / localDir[0], 1.0f / localDir[1], 1.0f / localDir[2] };
+                if (rayHitsBounds(localOrigin, localInvDir, box.localMin, box.localMax, hitT, tNear)) {
+                    hitT = tNear;
+                    hit = bvh.order[i];
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first; the farther one is often skipped once hitT shrinks
+        const BvhNode& a = bvh.nodes[node.first];
+        const BvhNode& b = bvh.nodes[node.first + 1];
+        float ta, tb;
+        bool hitA = rayHitsBounds(origin, invDir, a.bmin, a.bmax, hitT, ta);
+        bool hitB = rayHitsBounds(origin, invDir, b.bmin, b.bmax, hitT, tb);
+        if (hitA && hitB) {
+            bool aFirst = ta <= tb;
+            stack[top++] = aFirst ? node.first + 1 : node.first;
+            stack[top++] = aFirst ? node.first : node.first + 1;
+        }
+        else if (hitA) stack[top++] = node.first;
+        else if (hitB) stack[top++] = node.first + 1;
+    }
+    return hit;
+}
+
+// Same transforms drawWindmill applies
+void windmillMatrix(int i, float* m) {
+    mat4Identity(m);
+    mat4Translate(m, windmillLayout[i][0], -5.0f, windmillLayout[i][1]);
+    mat4Scale(m, windmillLayout[i][2], windmillLayout[i][2], windmillLayout[i][2]);
+}
+
+void bladeMatrix(int i, int blade, float* m) {
+    windmillMatrix(i, m);
+    mat4Translate(m, 0.0f, 18.0f, 0.5f);
+    mat4Rotate(m, windmillLayout[i][3] + windmillAngle, 0, 0, 1);
+    mat4Rotate(m, blade * 120.0f, 0, 0, 1);
+    mat4Translate(m, 0.0f, 6.0f, 0.0f);
+}
+
+const float BLADE_MIN[3] = { -0.3f, -6.0f, -0.1f };
+const float BLADE_MAX[3] = { 0.3f, 6.0f, 0.1f };
+
+void initPicking() {
+    Bvh& bvh = sceneBvh;
+    bvh.boxes.clear();
+    float m[16];
+
+    // Trees: trunk and crown, in drawTree's 0.6 scaled space
+    const float trunkMin[] = { -1.0f, 0.0f, -1.0f }, trunkMax[] = { 1.0f, 5.0f, 1.0f };
+    const float crownMin[] = { -4.0f, 4.0f, -4.0f }, crownMax[] = { 4.0f, 14.0f, 4.0f };
+    for (int i = 0; i < NUM_TREES; i++) {
+        mat4Identity(m);
+        mat4Translate(m, treePositions[i][0], -5.0f, treePositions[i][1]);
+        mat4Scale(m, 0.6f, 0.6f, 0.6f);
+        addPickBox(bvh, m, trunkMin, trunkMax, PICK_TREE, i);
+        addPickBox(bvh, m, crownMin, crownMax, PICK_TREE, i);
+    }
+
+    // Windmills: pole and hub, then all blades together so refits can find them
+    const float poleMin[] = { -0.6f, 0.0f, -0.6f }, poleMax[] = { 0.6f, 18.0f, 0.6f };
+    const float hubMin[] = { -1.0f, 17.0f, -0.5f }, hubMax[] = { 1.0f, 19.0f, 1.5f };
+    for (int i = 0; i < NUM_WINDMILLS; i++) {
+        windmillMatrix(i, m);
+        addPickBox(bvh, m, poleMin, poleMax, PICK_WINDMILL, i);
+        addPickBox(bvh, m, hubMin, hubMax, PICK_WINDMILL, i);
+    }
+    bladeBoxFirst = (int)bvh.boxes.size();
+    for (int i = 0; i < NUM_WINDMILLS; i++) {
+        for (int blade = 0; blade < 3; blade++) {
+            bladeMatrix(i, blade, m);
+            addPickBox(bvh, m, BLADE_MIN, BLADE_MAX, PICK_WINDMILL, i);
+        }
+    }
+    refitWindmillAngle = windmillAngle;
+
+    // Sign: one box per block, placed like drawText3D
+    VoxelGrid grid;
+    layoutText(signText, grid);
+    signGlyphStart = grid.glyphStart;
+    mat4Identity(m);
+    mat4Translate(m, 10.0f, 5.0f, 10.0f);
+    mat4Scale(m, 2.5f, 2.5f, 2.5f);
+    for (size_t i = 0; i < signText.size(); i++) {
+        int start = grid.glyphStart[i];
+        int end = start + glyphWidth(findGlyph(signText[i]));
+        for (int y = 0; y < GLYPH_ROWS; y++) {
+            for (int x = start; x < end; x++) {
+                if (!grid.cells[y * grid.width + x]) continue;
+                float blockMin[] = { x - 0.5f, y - 0.5f, -0.5f }, blockMax[] = { x + 0.5f, y + 0.5f, 0.5f };
+                addPickBox(bvh, m, blockMin, blockMax, PICK_LETTER, (int)i);
+            }
+        }
+    }
+
+    buildBvh(bvh);
+}
+
+// Called every animation tick; moves the blade boxes and refits, no rebuild
+void refitWindmillBlades() {
+    if (windmillAngle == refitWindmillAngle) return;
+    refitWindmillAngle = windmillAngle;
+    float m[16];
+    for (int i = 0; i < NUM_WINDMILLS; i++) {
+        for (int blade = 0; blade < 3; blade++) {
+            bladeMatrix(i, blade, m);
+            setPickBox(sceneBvh.boxes[bladeBoxFirst + i * 3 + blade], m, BLADE_MIN, BLADE_MAX);
+        }
+    }
+    refitBvh(sceneBvh);
+}
+
+// World space ray through a window pixel, for the camera rotX / rotY / zoom
+// describe and the projection reshape set up
+void screenRay(int x, int y, float* origin, float* dir) {
+    updateCamera();
+    float ndcX = 2.0f * (x + 0.5f) / viewportWidth - 1.0f;
+    float ndcY = 1.0f - 2.0f * (y + 0.5f) / viewportHeight;
+    float eyeDir[3] = { ndcX / projectionMatrix[0], ndcY / projectionMatrix[5], -1.0f };
+    float cameraToWorld[16];
+    mat4AffineInverse(cameraToWorld, viewMatrix);
+    std::copy(cameraToWorld + 12, cameraToWorld + 15, origin);
+    transformDirection(cameraToWorld, eyeDir, dir);
+}
+
+void pickAt(int x, int y) {
+    float origin[3], dir[3];
+    screenRay(x, y, origin, dir);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    float t;
+    int visited;
+    int hit = raycastBvh(sceneBvh, origin, dir, t, visited);
+    float us = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    pickCount++;
+    lastPickUs = us;
+    lastPickNodes = visited;
+
+    if (hit < 0) {
+        selectedKind = PICK_NONE;
+        selectedIndex = -1;
+    }
+    else {
+        selectedKind = sceneBvh.boxes[hit].kind;
+        selectedIndex = sceneBvh.boxes[hit].index;
+    }
+}
+
+// --pick-bench=N: times a hierarchy over N random rotated boxes spread over 2 km
+void runPickBenchmark(int count) {
+    const int RAYS = 10000;
+    Bvh bvh;
+    std::mt19937 rng(99);
+    float m[16];
+    for (int i = 0; i < count; i++) {
+        mat4Identity(m);
+        mat4Translate(m, randomRange(rng, -1000.0f, 1000.0f), randomRange(rng, 0.0f, 50.0f), randomRange(rng, -1000.0f, 1000.0f));
+        mat4Rotate(m, randomRange(rng, 0.0f, 360.0f), randomRange(rng, -1.0f, 1.0f), 1.0f, randomRange(rng, -1.0f, 1.0f));
+        float half[3] = { randomRange(rng, 0.5f, 3.0f), randomRange(rng, 0.5f, 3.0f), randomRange(rng, 0.5f, 3.0f) };
+        float boxMin[] = { -half[0], -half[1], -half[2] };
+        addPickBox(bvh, m, boxMin, half, PICK_NONE, i);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    buildBvh(bvh);
+    float buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    refitBvh(bvh);
+    float refitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Rays from above the field down to random points on it, like clicks from a high camera
+    std::vector<float> rays(RAYS * 6);
+    for (int r = 0; r < RAYS; r++) {
+        float* ray = &rays[r * 6];
+        ray[0] = randomRange(rng, -1000.0f, 1000.0f);
+        ray[1] = 300.0f;
+        ray[2] = randomRange(rng, -1000.0f, 1000.0f);
+        ray[3] = randomRange(rng, -1000.0f, 1000.0f) - ray[0];
+        ray[4] = -ray[1];
+        ray[5] = randomRange(rng, -1000.0f, 1000.0f) - ray[2];
+    }
+    int hits = 0;
+    long long visitedTotal = 0;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < RAYS; r++) {
+        float t;
+        int visited;
+        if (raycastBvh(bvh, &rays[r * 6], &rays[r * 6 + 3], t, visited) >= 0) hits++;
+        visitedTotal += visited;
+    }
+    float pickUs = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count() / RAYS;
+
+    std::cout << "Pick benchmark: " << count << " boxes, " << bvh.nodes.size() << " nodes | build " << buildMs
+        << " ms, refit " << refitMs << " ms | " << pickUs << " us per pick, " << visitedTotal / RAYS
+        << " nodes per pick, " << hits << "/" << RAYS << " hit" << std::endl;
+}
+
+// --- Terrain ---
+// The land behind the beach is a heightmap cut into square tiles. A tile's
+// heights are generated on background threads into a fixed grid of tile
+// records addressed by tile coordinates modulo TERRAIN_GRID, so the height
+// memory never grows however far the terrain reaches. Tiles are meshed with
+// geomipmapping: farther tiles use every 2nd, 4th, ... sample, and edge
+// vertices next to a coarser neighbour are moved onto the neighbour's edge so
+// no cracks open between levels. Meshes live in a fixed pool of mesh slots
+// reused least recently drawn first, and meshing stops once the frame's
+// time budget is spent.
+// Where the scene is, the ground stays flat at y = -5; hills rise away from it.
+
+const float TILE_SIZE = 50.0f;
+const int TILE_QUADS = 32;                      // Per side at full detail
+const int TILE_SAMPLES = TILE_QUADS + 3;        // Plus a border sample each side for normals
+const int TERRAIN_MAX_LOD = 5;                  // 1 quad per side
+const float TERRAIN_LOD_DISTANCE = 100.0f;      // Full detail inside this, halved every doubling
+const float TERRAIN_VIEW_RADIUS = 900.0f;
+const int TERRAIN_GRID = 40;                    // Tile records per side; covers the view diameter
+const int TERRAIN_MESH_SLOTS = 512;
+const float TERRAIN_BUILD_MS = 2.0f;              // Meshing time allowed per frame
+const int TERRAIN_WORKERS = 2;
+const float BEACH_Z = -20.0f;                   // Terrain tiles stop here; the sand takes over
+const float GROUND_Y = -5.0f;
+
+enum { TILE_EMPTY, TILE_QUEUED, TILE_READY };
+
+struct TerrainTile {
+    int tileX, tileZ;                           // Tile covers x from tileX * TILE_SIZE, z from BEACH_Z + tileZ * TILE_SIZE
+    std::atomic<int> state;                     // Workers only touch heights while QUEUED
+    float minY, maxY;
+    float heights[TILE_SAMPLES * TILE_SAMPLES];
+    int meshSlot;                               // Last slot built for this tile, may since be reused
+};
+
+struct TerrainMeshSlot {
+    int mesh;
+    int tileX, tileZ;
+    int key;                                    // LOD and edge LODs it was built with
+    int lastUsed;                               // Frame it was last drawn
+};
+
+TerrainTile terrainTiles[TERRAIN_GRID * TERRAIN_GRID];
+TerrainMeshSlot terrainSlots[TERRAIN_MESH_SLOTS];
+int terrainFrame = 0;
+
+std::vector<std::thread> terrainThreads;
+std::mutex terrainMutex;
+std::condition_variable terrainWake;
+int terrainQueue[TERRAIN_GRID * TERRAIN_GRID]; // Ring of tile records waiting for heights
+int terrainQueueHead = 0, terrainQueueTail = 0;
+bool terrainQuit = false;
+
+float smoothStep(float edge0, float edge1, float x) {
+    float t = std::max(0.0f, std::min(1.0f, (x - edge0) / (edge1 - edge0)));
+    return t * t * (3.0f - 2.0f * t);
+}
+
+float latticeValue(int x, int z) {
+    unsigned int h = (unsigned int)x * 374761393u + (unsigned int)z * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return ((h ^ (h >> 16)) & 0xffff) / 65535.0f;
+}
+
+float valueNoise(float x, float z) {
+    float fx = floor(x), fz = floor(z);
+    int ix = (int)fx, iz = (int)fz;
+    float tx = smoothStep(0.0f, 1.0f, x - fx), tz = smoothStep(0.0f, 1.0f, z - fz);
+    float a = latticeValue(ix, iz) + (latticeValue(ix + 1, iz) - latticeValue(ix, iz)) * tx;
+    float b = latticeValue(ix, iz + 1) + (latticeValue(ix + 1, iz + 1) - latticeValue(ix, iz + 1)) * tx;
+    return a + (b - a) * tz;
+}
+
+float terrainHeight(float x, float z) {
+    if (z >= BEACH_Z) return GROUND_Y;
+    // Flat under the scene and along the beach, hills further out
+    float outX = std::max(0.0f, std::abs(x) - 100.0f);
+    float outZ = std::max(0.0f, -150.0f - z);
+    float ramp = smoothStep(0.0f, 150.0f, sqrt(outX * outX + outZ * outZ)) * smoothStep(0.0f, 60.0f, BEACH_Z - z);
+    if (ramp <= 0.0f) return GROUND_Y;
+
+    float sum = 0.0f, amplitude = 1.0f, frequency = 1.0f / 300.0f, total = 0.0f;
+    for (int octave = 0; octave < 5; octave++) {
+        sum += valueNoise(x * frequency + octave * 17.0f, z * frequency) * amplitude;
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    float hills = sum / total;
+    return GROUND_Y + ramp * hills * hills * 220.0f;
+}
+
+// Runs on a worker thread
+void generateTerrainTile(TerrainTile& tile) {
+    float spacing = TILE_SIZE / TILE_QUADS;
+    float x0 = tile.tileX * TILE_SIZE - spacing;
+    float z0 = BEACH_Z + tile.tileZ * TILE_SIZE - spacing;
+    tile.minY = 1e30f;
+    tile.maxY = -1e30f;
+    for (int v = 0; v < TILE_SAMPLES; v++) {
+        for (int u = 0; u < TILE_SAMPLES; u++) {
+            float h = terrainHeight(x0 + u * spacing, z0 + v * spacing);
+            tile.heights[v * TILE_SAMPLES + u] = h;
+            tile.minY = std::min(tile.minY, h);
+            tile.maxY = std::max(tile.maxY, h);
+        }
+    }
+}
+
+void terrainWorker() {
+    while (true) {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(terrainMutex);
+            terrainWake.wait(lock, [] { return terrainQuit || terrainQueueHead != terrainQueueTail; });
+            if (terrainQuit) return;
+            index = terrainQueue[terrainQueueHead];
+            terrainQueueHead = (terrainQueueHead + 1) % (TERRAIN_GRID * TERRAIN_GRID);
+        }
+        generateTerrainTile(terrainTiles[index]);
+        terrainTiles[index].state.store(TILE_READY, std::memory_order_release);
+    }
+}
+
+void shutdownTerrain() {
+    {
+        std::lock_guard<std::mutex> lock(terrainMutex);
+        terrainQuit = true;
+    }
+    terrainWake.notify_all();
+    for (std::thread& t : terrainThreads) t.join();
+    terrainThreads.clear();
+}
+
+void initTerrain() {
+    for (int i = 0; i < TERRAIN_MESH_SLOTS; i++) {
+        TerrainMeshSlot slot = { createMesh(true), 0, 0, -1, -1 }; // key -1: holds nothing yet
+        terrainSlots[i] = slot;
+    }
+    for (int i = 0; i < TERRAIN_GRID * TERRAIN_GRID; i++) terrainTiles[i].meshSlot = -1;
+    for (int i = 0; i < TERRAIN_WORKERS; i++) terrainThreads.push_back(std::thread(terrainWorker));
+    atexit(shutdownTerrain);
+}
+
+TerrainTile& terrainTileRecord(int tileX, int tileZ) {
+    int gx = ((tileX % TERRAIN_GRID) + TERRAIN_GRID) % TERRAIN_GRID;
+    int gz = ((tileZ % TERRAIN_GRID) + TERRAIN_GRID) % TERRAIN_GRID;
+    return terrainTiles[gz * TERRAIN_GRID + gx];
+}
+
+// Horizontal distance only, so both sides of an edge agree on each other's LOD
+int terrainLod(int tileX, int tileZ, const float* camera) {
+    float dx = (tileX + 0.5f) * TILE_SIZE - camera[0];
+    float dz = BEACH_Z + (tileZ + 0.5f) * TILE_SIZE - camera[2];
+    float d = sqrt(dx * dx + dz * dz);
+    if (d < TERRAIN_LOD_DISTANCE) return 0;
+    return std::min(TERRAIN_MAX_LOD, (int)floor(log2(d / TERRAIN_LOD_DISTANCE)) + 1);
+}
+
+// Least recently drawn slot that is not in use this frame, or -1
+int acquireTerrainSlot() {
+    int best = -1;
+    for (int i = 0; i < TERRAIN_MESH_SLOTS; i++) {
+        if (terrainSlots[i].lastUsed == terrainFrame) continue;
+        if (best < 0 || terrainSlots[i].lastUsed < terrainSlots[best].lastUsed) best = i;
+    }
+    if (best >= 0 && terrainSlots[best].key >= 0) frameStats.terrainEvicted++;
+    return best;
+}
+
+// Meshes a tile at one LOD; edgeLods are the (never finer) levels of the
+// neighbours toward -z, +x, +z and -x
+void buildTerrainMesh(const TerrainTile& tile, int lod, const int* edgeLods, Mesh& m) {
+    m.vertices.clear();
+    m.indices.clear();
+    int step = 1 << lod;
+    int quads = TILE_QUADS / step;
+    float spacing = TILE_SIZE / TILE_QUADS;
+    float x0 = tile.tileX * TILE_SIZE;
+    float z0 = BEACH_Z + tile.tileZ * TILE_SIZE;
+    // Heights by full-detail sample index, 0..TILE_QUADS inside the tile
+    auto height = [&](int u, int v) { return tile.heights[(v + 1) * TILE_SAMPLES + u + 1]; };
+
+    for (int v = 0; v <= TILE_QUADS; v += step) {
+        for (int u = 0; u <= TILE_QUADS; u += step) {
+            float h = height(u, v);
+            // Snap onto a coarser neighbour's edge: interpolate between its samples.
+            // Corners are shared by every level, so they never move.
+            int edge = v == 0 ? 0 : (v == TILE_QUADS ? 2 : (u == 0 ? 3 : (u == TILE_QUADS ? 1 : -1)));
+            if (edge >= 0) {
+                int coarse = 1 << edgeLods[edge];
+                bool alongU = edge == 0 || edge == 2;
+                int t = alongU ? u : v;
+                if (t % coarse != 0) {
+                    int t0 = t - t % coarse;
+                    float a = alongU ? height(t0, v) : height(u, t0);
+                    float b = alongU ? height(t0 + coarse, v) : height(u, t0 + coarse);
+                    h = a + (b - a) * (t % coarse) / (float)coarse;
+                }
+            }
+            // Normal from the full-detail neighbours (border samples included)
+            float nx = height(u - 1, v) - height(u + 1, v);
+            float nz = height(u, v - 1) - height(u, v + 1);
+            float ny = 2.0f * spacing;
+            float len = sqrt(nx * nx + ny * ny + nz * nz);
+            addVertex(m, x0 + u * spacing, h, z0 + v * spacing, nx / len, ny / len, nz / len);
+        }
+    }
+    addGridIndices(m, 0, quads, quads);
+}
+
+// Returns true if the box is entirely outside one of the frustum's side, near or far planes
+bool boxOutsideFrustum(const float* bmin, const float* bmax) {
+    int outside[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int c = 0; c < 8; c++) {
+        float p[3] = { (c & 1) ? bmax[0] : bmin[0], (c & 2) ? bmax[1] : bmin[1], (c & 4) ? bmax[2] : bmin[2] };
+        float clip[4];
+        transformPoint(viewProjMatrix, p, clip);
+        for (int a = 0; a < 3; a++) {
+            if (clip[a] < -clip[3]) outside[a * 2]++;
+            if (clip[a] > clip[3]) outside[a * 2 + 1]++;
+        }
+    }
+    for (int i = 0; i < 6; i++) {
+        if (outside[i] == 8) return true;
+    }
+    return false;
+}
+
+// Requests, meshes and draws every tile near the camera, nearest first
+void drawTerrain(float dim) {
+    terrainFrame++;
+    float cameraToWorld[16];
+    mat4AffineInverse(cameraToWorld, viewMatrix);
+    const float* camera = cameraToWorld + 12;
+    int centerX = (int)floor(camera[0] / TILE_SIZE);
+    int centerZ = (int)floor((camera[2] - BEACH_Z) / TILE_SIZE);
+    int rings = (int)ceil(TERRAIN_VIEW_RADIUS / TILE_SIZE);
+    int builds = 0;
+    bool queued = false;
+    std::chrono::steady_clock::time_point buildStart = std::chrono::steady_clock::now();
+    bool buildTime = true;
+
+    sceneColor3f(0.1f * dim, 0.45f * dim, 0.1f * dim); // Forest Green
+    for (int ring = 0; ring <= rings; ring++) {
+        for (int tz = centerZ - ring; tz <= centerZ + ring; tz++) {
+            // The whole ring's outline: every column on the first and last rows, the two ends otherwise
+            int stepX = (tz == centerZ - ring || tz == centerZ + ring) ? 1 : std::max(1, 2 * ring);
+            for (int tx = centerX - ring; tx <= centerX + ring; tx += stepX) {
+                if (tz >= 0) continue; // Beach and sea
+                float dx = (tx + 0.5f) * TILE_SIZE - camera[0];
+                float dz = BEACH_Z + (tz + 0.5f) * TILE_SIZE - camera[2];
+                if (sqrt(dx * dx + dz * dz) > TERRAIN_VIEW_RADIUS + TILE_SIZE * 0.71f) continue;
+
+                TerrainTile& tile = terrainTileRecord(tx, tz);
+                int state = tile.state.load(std::memory_order_acquire);
+                if (state == TILE_EMPTY || tile.tileX != tx || tile.tileZ != tz) {
+                    if (state == TILE_QUEUED) continue; // Still generating whatever tile it held
+                    tile.tileX = tx;
+                    tile.tileZ = tz;
+                    tile.state.store(TILE_QUEUED, std::memory_order_relaxed);
+                    {
+                        std::lock_guard<std::mutex> lock(terrainMutex);
+                        terrainQueue[terrainQueueTail] = (int)(&tile - terrainTiles);
+                        terrainQueueTail = (terrainQueueTail + 1) % (TERRAIN_GRID * TERRAIN_GRID);
+                    }
+                    queued = true;
+                    frameStats.terrainPending++;
+                    continue;
+                }
+                if (state != TILE_READY) {
+                    frameStats.terrainPending++;
+                    continue;
+                }
+
+                float bmin[3] = { tx * TILE_SIZE, tile.minY, BEACH_Z + tz * TILE_SIZE };
+                float bmax[3] = { bmin[0] + TILE_SIZE, tile.maxY, bmin[2] + TILE_SIZE };
+                if (boxOutsideFrustum(bmin, bmax)) continue;
+
+                int lod = terrainLod(tx, tz, camera);
+                int edgeLods[4] = {
+                    std::max(lod, terrainLod(tx, tz - 1, camera)), std::max(lod, terrainLod(tx + 1, tz, camera)),
+                    std::max(lod, terrainLod(tx, tz + 1, camera)), std::max(lod, terrainLod(tx - 1, tz, camera))
+                };
+                int key = lod | edgeLods[0] << 3 | edgeLods[1] << 6 | edgeLods[2] << 9 | edgeLods[3] << 12;
+
+                int slot = tile.meshSlot;
+                bool owned = slot >= 0 && terrainSlots[slot].tileX == tx && terrainSlots[slot].tileZ == tz && terrainSlots[slot].key >= 0;
+                if ((!owned || terrainSlots[slot].key != key) && buildTime) {
+                    // Rebuild in place if this tile already has a slot, else take the oldest one
+                    int target = owned ? slot : acquireTerrainSlot();
+                    if (target >= 0) {
+                        TerrainMeshSlot& s = terrainSlots[target];
+                        buildTerrainMesh(tile, lod, edgeLods, meshes[s.mesh]);
+                        commitMesh(s.mesh);
+                        s.tileX = tx;
+                        s.tileZ = tz;
+                        s.key = key;
+                        tile.meshSlot = target;
+                        slot = target;
+                        owned = true;
+                        builds++;
+                        buildTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - buildStart).count() < TERRAIN_BUILD_MS;
+                    }
+                }
+                // A slot built for an older LOD still beats a hole until its turn comes
+                if (!owned) continue;
+                terrainSlots[slot].lastUsed = terrainFrame;
+                sceneDrawMesh(terrainSlots[slot].mesh);
+                frameStats.terrainTiles++;
+            }
+        }
+    }
+    if (queued) terrainWake.notify_all();
+    frameStats.terrainBuilt += builds;
 }
 
 // --- Scene Objects ---
 
+// Lamps: every one is a point light for the clustered shader and, apart from
+// the sign's glow, a small bulb in the scene
+
+const int BEACH_LAMPS = 20;        // Every 10 units along the sand, x = -95..95
+const float BEACH_LAMP_Z = 22.0f;
+
+std::vector<PointLight> staticLights; // All lamps but the blade tips, at full brightness
+float lampGlow = 0.0f;                // 0 by day, 1 at night
+
+// Lamps fade in at dusk and out at dawn
+float lampLevel() {
+    if (timeOfDay < 80.0f || timeOfDay > 280.0f) return 0.0f;
+    if (timeOfDay < 100.0f) return (timeOfDay - 80.0f) / 20.0f;
+    if (timeOfDay > 260.0f) return (280.0f - timeOfDay) / 20.0f;
+    return 1.0f;
+}
+
+void addStaticLight(float x, float y, float z, float radius, float r, float g, float b) {
+    if ((int)staticLights.size() >= MAX_POINT_LIGHTS - NUM_WINDMILLS * 3) return;
+    PointLight light = { { x, y, z }, radius, { r, g, b } };
+    staticLights.push_back(light);
+}
+
+void initSceneLights(int extraLights) {
+    float m[16];
+    for (int i = 0; i < BEACH_LAMPS; i++) {
+        addStaticLight(-95.0f + i * 10.0f, -1.0f, BEACH_LAMP_Z, 14.0f, 1.0f, 0.8f, 0.5f);
+    }
+    // Lanterns hang beside each trunk (see drawTree)
+    for (int i = 0; i < NUM_TREES; i++) {
+        addStaticLight(treePositions[i][0] + 2.1f, -3.2f, treePositions[i][1], 9.0f, 1.0f, 0.6f, 0.25f);
+    }
+    // Red lamp on the front of every hub
+    for (int i = 0; i < NUM_WINDMILLS; i++) {
+        float p[3] = { 0.0f, 18.0f, 1.7f }, w[4];
+        windmillMatrix(i, m);
+        transformPoint(m, p, w);
+        addStaticLight(w[0], w[1], w[2], 10.0f * windmillLayout[i][2], 1.0f, 0.2f, 0.1f);
+    }
+    // The sign glows: one wider light in front of every letter, at the middle of
+    // its blocks and brighter the more blocks it has, so long signs stay cheap
+    VoxelGrid grid;
+    layoutText(signText, grid);
+    for (size_t i = 0; i < signText.size(); i++) {
+        int start = grid.glyphStart[i];
+        int end = start + glyphWidth(findGlyph(signText[i]));
+        float sumX = 0.0f, sumY = 0.0f;
+        int blocks = 0;
+        for (int y = 0; y < GLYPH_ROWS; y++) {
+            for (int x = start; x < end; x++) {
+                if (!grid.cells[y * grid.width + x]) continue;
+                sumX += x;
+                sumY += y;
+                blocks++;
+            }
+        }
+        if (blocks == 0) continue; // Space
+        float glow = 0.5f * blocks;
+        addStaticLight(10.0f + 2.5f * sumX / blocks, 5.0f + 2.5f * sumY / blocks, 17.0f, 22.0f,
+            0.35f * glow, 0.2f * glow, 0.07f * glow);
+    }
+    // --extra-lights: scattered ground lights, for scaling tests
+    std::mt19937 rng(77);
+    for (int i = 0; i < extraLights; i++) {
+        addStaticLight(randomRange(rng, -100.0f, 100.0f), -4.0f, randomRange(rng, -150.0f, 28.0f), randomRange(rng, 5.0f, 12.0f),
+            randomRange(rng, 0.3f, 1.0f), randomRange(rng, 0.3f, 1.0f), randomRange(rng, 0.3f, 1.0f));
+    }
+    std::cout << " Point lights in the scene: " << staticLights.size() + NUM_WINDMILLS * 3 << std::endl;
+}
+
+// Fills pointLights for this frame; the blade tip lamps turn with the blades
+void updateSceneLights() {
+    lampGlow = lampLevel();
+    pointLights.clear();
+    if (lampGlow <= 0.0f || !clusteredLightingSupported) return;
+    for (const PointLight& light : staticLights) pointLights.push_back(light);
+    float m[16];
+    for (int i = 0; i < NUM_WINDMILLS; i++) {
+        for (int blade = 0; blade < 3; blade++) {
+            float p[3] = { 0.0f, 6.0f, 0.3f };
+            PointLight light = { {}, 8.0f * windmillLayout[i][2], { 1.0f, 0.85f, 0.5f } };
+            bladeMatrix(i, blade, m);
+            transformPoint(m, p, light.pos);
+            pointLights.push_back(light);
+        }
+    }
+    for (PointLight& light : pointLights) {
+        for (int c = 0; c < 3; c++) light.color[c] *= lampGlow;
+    }
+}
+
+// Bulbs are grey glass by day and take the lamp's colour as it comes on
+void sceneLampColor(float r, float g, float b) {
+    float off[3] = { 0.55f, 0.55f, 0.5f };
+    float on[3] = { r, g, b };
+    float c[3];
+    mixColor(c, off, on, lampGlow);
+    sceneColor3fv(c);
+}
+
+void drawBeachLamps() {
+    for (int i = 0; i < BEACH_LAMPS; i++) {
+        scenePushMatrix();
+        sceneTranslatef(-95.0f + i * 10.0f, -5.0f, BEACH_LAMP_Z);
+        sceneColor3f(0.25f, 0.25f, 0.25f);
+        scenePushMatrix();
+        sceneRotatef(-90, 1, 0, 0);
+        drawCylinder(0.15f, 0.15f, 3.6f);
+        scenePopMatrix();
+        sceneLampColor(1.0f, 0.9f, 0.6f);
+        sceneTranslatef(0.0f, 4.0f, 0.0f);
+        sceneSolidSphere(0.5f, 8, 8);
+        scenePopMatrix();
+    }
+}
+
 void drawCelestialBodies() {
-    glPushMatrix();
-    // Rotate the whole celestial system based on timeOfDay
-    glRotatef(timeOfDay, 0.0f, 0.0f, 1.0f);
+    // The whole celestial system rotates about Z based on timeOfDay
+    // Sun and moon sit at z = -200 so they set BEHIND the mountains,
+    // on an orbit radius of 90 to be visible over them
+    float angle = timeOfDay * PI / 180.0f;
+    float orbitX = -90.0f * sin(angle);
+    float orbitY = 90.0f * cos(angle);
 
     // SUN
-    glPushMatrix();
-    // Moved sun further back (z = -200) so it sets BEHIND mountains
-    // Increased orbit radius to 90 to be visible over mountains
-    glTranslatef(0.0f, 90.0f, -200.0f);
-    // Sun Color Logic (Yellow at noon, Redder at horizon)
-    if (timeOfDay > 60 && timeOfDay < 120) glColor3f(1.0f, 0.4f, 0.0f); // Sunset Orange
-    else if (timeOfDay > 240 && timeOfDay < 300) glColor3f(1.0f, 0.5f, 0.2f); // Sunrise Orange
-    else glColor3f(1.0f, 0.9f, 0.0f); // Noon Yellow
-
-    glutSolidSphere(12.0f, 30, 30); // Slightly larger sun
-    glPopMatrix();
-
-    // MOON (Opposite side)
-    glPushMatrix();
-    glTranslatef(0.0f, -90.0f, -200.0f); // Match Sun's depth
-    glColor3f(0.9f, 0.9f, 0.9f); // White/Grey Moon
-    glutSolidSphere(8.0f, 20, 20);
-    glPopMatrix();
-
-    glPopMatrix();
-}
-
-void drawCloud(float x, float y, float z, float scale) {
-    // Dynamic Cloud Colors based on Cycle
-    float cloudColor[3];
+    float sunMin[] = { orbitX - 12.0f, orbitY - 12.0f, -212.0f };
+    float sunMax[] = { orbitX + 12.0f, orbitY + 12.0f, -188.0f };
+    if (beginOcclusionTest(OCC_SUN, sunMin, sunMax)) {
+        scenePushMatrix();
+        sceneTranslatef(orbitX, orbitY, -200.0f);
+        // Sun Color Logic (Yellow at noon, Redder at horizon)
+        if (timeOfDay > 60 && timeOfDay < 120) sceneColor3f(1.0f, 0.4f, 0.0f); // Sunset Orange
+        else if (timeOfDay > 240 && timeOfDay < 300) sceneColor3f(1.0f, 0.5f, 0.2f); // Sunrise Orange
+        else sceneColor3f(1.0f, 0.9f, 0.0f); // Noon Yellow
+
+        sceneSolidSphere(12.0f, 30, 30); // Slightly larger sun
+        scenePopMatrix();
+        endOcclusionTest();
+    }
+
+    // MOON (Opposite side, matching the Sun's depth)
+    float moonMin[] = { -orbitX - 8.0f, -orbitY - 8.0f, -208.0f };
+    float moonMax[] = { -orbitX + 8.0f, -orbitY + 8.0f, -192.0f };
+    if (beginOcclusionTest(OCC_MOON, moonMin, moonMax)) {
+        scenePushMatrix();
+        sceneTranslatef(-orbitX, -orbitY, -200.0f);
+        sceneColor3f(0.9f, 0.9f, 0.9f); // White/Grey Moon
+        sceneSolidSphere(8.0f, 20, 20);
+        scenePopMatrix();
+        endOcclusionTest();
+    }
+}
+
+// Dynamic Cloud Colors based on Cycle
+void getCloudColor(float* cloudColor) {
     float dayCloud[] = { 0.95f, 0.95f, 1.0f };      // White
     float sunsetCloud[] = { 1.0f, 0.7f, 0.6f };     // Pinkish Orange
     float nightCloud[] = { 0.2f, 0.2f, 0.25f };     // Dark Grey
@@ -108,75 +3379,63 @@ void drawCloud(float x, float y, float z, float scale) {
         mixColor(cloudColor, sunriseCloud, dayCloud, t);
     }
     else std::copy(dayCloud, dayCloud + 3, cloudColor);
-
-    glColor3fv(cloudColor);
-
-    glPushMatrix();
-    glTranslatef(x, y, z);
-    glScalef(scale, scale, scale);
-
-    glutSolidSphere(3.0f, 10, 10);
-    glTranslatef(3.5f, 0.0f, 0.0f);
-    glutSolidSphere(2.5f, 10, 10);
-    glTranslatef(-1.5f, 2.0f, 0.5f);
-    glutSolidSphere(2.5f, 10, 10);
-
-    glPopMatrix();
 }
 
 void drawTree(float x, float z) {
     float dim = 1.0f;
     if (timeOfDay > 100 && timeOfDay < 260) dim = 0.4f;
 
-    glPushMatrix();
-    glTranslatef(x, -5.0f, z);
+    scenePushMatrix();
+    sceneTranslatef(x, -5.0f, z);
     // Make trees smaller by scaling down
-    glScalef(0.6f, 0.6f, 0.6f);
+    sceneScalef(0.6f, 0.6f, 0.6f);
 
     // Trunk
-    glColor3f(0.4f * dim, 0.3f * dim, 0.1f * dim); // Brown
-    glPushMatrix();
-    glRotatef(-90, 1, 0, 0);
+    sceneColor3f(0.4f * dim, 0.3f * dim, 0.1f * dim); // Brown
+    scenePushMatrix();
+    sceneRotatef(-90, 1, 0, 0);
     drawCylinder(1.0f, 1.0f, 5.0f);
-    glPopMatrix();
+    scenePopMatrix();
 
     // Foliage
-    glColor3f(0.05f * dim, 0.4f * dim, 0.05f * dim); // Dark Green
-    glPushMatrix();
-    glTranslatef(0.0f, 4.0f, 0.0f);
-    glRotatef(-90, 1, 0, 0);
-    glutSolidCone(4.0f, 10.0f, 10, 10);
-    glPopMatrix();
-
-    glPopMatrix();
+    sceneColor3f(0.05f * dim, 0.4f * dim, 0.05f * dim); // Dark Green
+    scenePushMatrix();
+    sceneTranslatef(0.0f, 4.0f, 0.0f);
+    sceneRotatef(-90, 1, 0, 0);
+    sceneSolidCone(4.0f, 10.0f, 10, 10);
+    scenePopMatrix();
+
+    // Lantern
+    sceneLampColor(1.0f, 0.7f, 0.35f);
+    scenePushMatrix();
+    sceneTranslatef(3.5f, 3.0f, 0.0f);
+    sceneSolidSphere(0.6f, 8, 8);
+    scenePopMatrix();
+
+    scenePopMatrix();
 }
 
 void drawVegetation() {
-    // Add MORE smaller Trees scattered around on the forest floor
-    // Original trees
-    drawTree(-70.0f, -40.0f);
-    drawTree(-50.0f, -80.0f);
-    drawTree(-80.0f, -120.0f);
-    drawTree(60.0f, -60.0f);
-    drawTree(80.0f, -100.0f);
-    drawTree(40.0f, -130.0f);
-    drawTree(20.0f, -110.0f);
-    drawTree(-20.0f, -140.0f);
+    // Smaller Trees scattered around on the forest floor
+    for (int i = 0; i < NUM_TREES; i++) {
+        float x = treePositions[i][0];
+        float z = treePositions[i][1];
+        // Trunk, foliage and lantern bounds after the 0.6 scale in drawTree
+        float treeMin[] = { x - 2.4f, -5.0f, z - 2.4f };
+        float treeMax[] = { x + 2.5f, 3.4f, z + 2.4f };
+        if (beginOcclusionTest(OCC_TREE_FIRST + i, treeMin, treeMax)) {
+            sceneHighlight = selectedKind == PICK_TREE && selectedIndex == i;
+            drawTree(x, z);
+            sceneHighlight = false;
+            endOcclusionTest();
+        }
+    }
+}
 
-    // New trees
-    drawTree(-30.0f, -20.0f);
-    drawTree(-10.0f, -45.0f);
-    drawTree(10.0f, -30.0f);
-    drawTree(30.0f, -50.0f);
-    drawTree(50.0f, -25.0f);
-    drawTree(-60.0f, -60.0f);
-    drawTree(-40.0f, -100.0f);
-    drawTree(0.0f, -80.0f);
-    drawTree(70.0f, -80.0f);
-    drawTree(-90.0f, -30.0f);
-    drawTree(90.0f, -40.0f);
-    drawTree(-15.0f, -70.0f);
-    drawTree(15.0f, -90.0f);
+void drawClouds() {
+    float cloudColor[3];
+    getCloudColor(cloudColor);
+    drawCloudParticles(cloudColor);
 }
 
 void drawMountains() {
@@ -184,178 +3443,182 @@ void drawMountains() {
     float dim = 1.0f;
     if (timeOfDay > 100 && timeOfDay < 260) dim = 0.3f;
 
-    glColor3f(0.13f * dim, 0.35f * dim, 0.05f * dim);
+    sceneColor3f(0.13f * dim, 0.35f * dim, 0.05f * dim);
 
-    glPushMatrix();
+    scenePushMatrix();
     // Move mountains further back to make room for forest
-    glTranslatef(0.0f, -5.0f, -150.0f);
-
-    // Main central peak
-    glPushMatrix();
-    glTranslatef(10.0f, 0.0f, 0.0f);
-    glRotatef(-90, 1, 0, 0);
-    glutSolidCone(30.0f, 45.0f, 10, 10);
-    glPopMatrix();
-
-    // Right peak
-    glPushMatrix();
-    glTranslatef(45.0f, -5.0f, 5.0f);
-    glRotatef(-90, 1, 0, 0);
-    glutSolidCone(25.0f, 35.0f, 10, 10);
-    glPopMatrix();
-
-    // Left peak
-    glPushMatrix();
-    glTranslatef(-30.0f, -5.0f, 5.0f);
-    glRotatef(-90, 1, 0, 0);
-    glutSolidCone(28.0f, 40.0f, 10, 10);
-    glPopMatrix();
-
-    // Far Left filler
-    glPushMatrix();
-    glTranslatef(-60.0f, -8.0f, 0.0f);
-    glRotatef(-90, 1, 0, 0);
-    glutSolidCone(20.0f, 30.0f, 10, 10);
-    glPopMatrix();
-
-    glPopMatrix();
+    sceneTranslatef(0.0f, -5.0f, -150.0f);
+
+    for (int i = 0; i < NUM_MOUNTAINS; i++) {
+        scenePushMatrix();
+        sceneTranslatef(mountainPeaks[i][0], mountainPeaks[i][1], mountainPeaks[i][2]);
+        sceneRotatef(-90, 1, 0, 0);
+        sceneSolidCone(mountainPeaks[i][3], mountainPeaks[i][4], 10, 10);
+        scenePopMatrix();
+    }
+
+    scenePopMatrix();
+}
+
+int sandMesh = -1;
+int seaMesh = -1; // Calm water either side of the wave grid
+int waterMesh = -1;
+
+const int WATER_ROWS = 24; // 5 unit strips from z = 30 to 150
+const int WATER_COLS = 20; // 10 unit steps from x = -100 to 100
+
+// Flat, upward facing quad on the ground plane
+int createGroundQuad(float x0, float x1, float y, float z0, float z1) {
+    int id = createMesh(false);
+    Mesh& m = meshes[id];
+    addVertex(m, x0, y, z0, 0.0f, 1.0f, 0.0f);
+    addVertex(m, x1, y, z0, 0.0f, 1.0f, 0.0f);
+    addVertex(m, x1, y, z1, 0.0f, 1.0f, 0.0f);
+    addVertex(m, x0, y, z1, 0.0f, 1.0f, 0.0f);
+    addTriangle(m, 0, 1, 2);
+    addTriangle(m, 0, 2, 3);
+    commitMesh(id);
+    return id;
+}
+
+void initGroundAndWater() {
+    // The forest floor is now part of the terrain; the beach runs as far as the terrain does
+    float reach = TERRAIN_VIEW_RADIUS + TILE_SIZE;
+    sandMesh = createGroundQuad(-reach, reach, -5.0f, -20.0f, 30.0f); // Meets Water / Terrain
+    seaMesh = createMesh(false);
+    Mesh& sea = meshes[seaMesh];
+    for (int side = 0; side < 2; side++) {
+        float x0 = side == 0 ? -reach : 100.0f;
+        float x1 = side == 0 ? -100.0f : reach;
+        unsigned int first = (unsigned int)sea.vertices.size();
+        addVertex(sea, x0, -5.5f, 30.0f, 0.0f, 1.0f, 0.0f);
+        addVertex(sea, x1, -5.5f, 30.0f, 0.0f, 1.0f, 0.0f);
+        addVertex(sea, x1, -5.5f, 150.0f, 0.0f, 1.0f, 0.0f);
+        addVertex(sea, x0, -5.5f, 150.0f, 0.0f, 1.0f, 0.0f);
+        addTriangle(sea, first, first + 1, first + 2);
+        addTriangle(sea, first, first + 2, first + 3);
+    }
+    commitMesh(seaMesh);
+
+    // The water grid keeps its topology; only the heights change each frame
+    waterMesh = createMesh(true);
+    Mesh& m = meshes[waterMesh];
+    m.vertices.resize((WATER_ROWS + 1) * (WATER_COLS + 1));
+    addGridIndices(m, 0, WATER_ROWS, WATER_COLS);
 }
 
 void drawGroundAndWater() {
     float dim = 1.0f;
     if (timeOfDay > 100 && timeOfDay < 260) dim = 0.4f;
 
-    // 1. FOREST (Green part) - At the back, before mountains
-    glColor3f(0.1f * dim, 0.45f * dim, 0.1f * dim); // Forest Green
-    glBegin(GL_QUADS);
-    glVertex3f(-100.0f, -5.0f, -20.0f);   // Meets Sand
-    glVertex3f(100.0f, -5.0f, -20.0f);
-    glVertex3f(100.0f, -5.0f, -150.0f);   // Meets Mountains
-    glVertex3f(-100.0f, -5.0f, -150.0f);
-    glEnd();
+    // 1. TERRAIN (Green part) - Forest floor and the hills behind it
+    drawTerrain(dim);
 
     // 2. SAND (Golden part) - In the middle
-    glColor3f(0.85f * dim, 0.75f * dim, 0.55f * dim); // Golden Sand
-    glBegin(GL_QUADS);
-    glVertex3f(-100.0f, -5.0f, 30.0f);    // Meets Water
-    glVertex3f(100.0f, -5.0f, 30.0f);
-    glVertex3f(100.0f, -5.0f, -20.0f);    // Meets Forest
-    glVertex3f(-100.0f, -5.0f, -20.0f);
-    glEnd();
+    sceneColor3f(0.85f * dim, 0.75f * dim, 0.55f * dim); // Golden Sand
+    sceneDrawMesh(sandMesh);
 
     // 3. WATER (Blue with WAVES) - At the front
-    // We render this as strips to animate vertices for the wave effect
-    glColor3f(0.0f * dim, 0.47f * dim, 0.75f * dim);
+    // The grid heights are animated for the wave effect
+    sceneColor3f(0.0f * dim, 0.47f * dim, 0.75f * dim);
+    sceneDrawMesh(seaMesh);
 
     float waterLevel = -5.5f;
-    // Loop through Z axis (from close to camera, to near sand)
-    // Adjusted start Z to 30.0f to meet the new sand edge
-    for (float z = 30.0f; z < 150.0f; z += 5.0f) {
-        glBegin(GL_QUAD_STRIP);
+    Mesh& water = meshes[waterMesh];
+    // Loop through Z axis (from the sand edge at 30 toward the camera)
+    for (int i = 0; i <= WATER_ROWS; i++) {
+        float z = 30.0f + i * 5.0f;
         // Loop through X axis
-        for (float x = -100.0f; x <= 100.0f; x += 10.0f) {
-            // Calculate Wave Height using Sine function dependent on Position + Time
-            float y1 = waterLevel + sin(x * 0.05f + z * 0.05f + wavePhase) * 0.8f;
-            float y2 = waterLevel + sin(x * 0.05f + (z + 5.0f) * 0.05f + wavePhase) * 0.8f;
-
-            glVertex3f(x, y1, z);
-            glVertex3f(x, y2, z + 5.0f);
+        for (int j = 0; j <= WATER_COLS; j++) {
+            float x = -100.0f + j * 10.0f;
+            // Calculate Wave Height using Sine function dependent on Position + Time,
+            // fading out over the last 20 units so the sides meet the calm sea flush
+            float fade = std::min(1.0f, (100.0f - std::abs(x)) / 20.0f);
+            float y = waterLevel + sin(x * 0.05f + z * 0.05f + wavePhase) * 0.8f * fade;
+            Vertex v = { { x, y, z }, { 0.0f, 1.0f, 0.0f } };
+            water.vertices[i * (WATER_COLS + 1) + j] = v;
         }
-        glEnd();
     }
+    commitMesh(waterMesh);
+    sceneDrawMesh(waterMesh);
 }
 
 void drawWindmill(float x, float z, float scale, float rotationOffset) {
     float dim = 1.0f;
     if (timeOfDay > 100 && timeOfDay < 260) dim = 0.5f;
 
-    glPushMatrix();
-    glTranslatef(x, -5.0f, z);
-    glScalef(scale, scale, scale);
+    scenePushMatrix();
+    sceneTranslatef(x, -5.0f, z);
+    sceneScalef(scale, scale, scale);
 
     // Pole
-    glColor3f(0.8f * dim, 0.8f * dim, 0.8f * dim);
-    glPushMatrix();
-    glRotatef(-90, 1, 0, 0);
+    sceneColor3f(0.8f * dim, 0.8f * dim, 0.8f * dim);
+    scenePushMatrix();
+    sceneRotatef(-90, 1, 0, 0);
     drawCylinder(0.6f, 0.4f, 18.0f);
-    glPopMatrix();
+    scenePopMatrix();
 
     // Hub Group
-    glPushMatrix();
-    glTranslatef(0.0f, 18.0f, 0.5f);
-    glRotatef(rotationOffset + windmillAngle, 0, 0, 1);
+    scenePushMatrix();
+    sceneTranslatef(0.0f, 18.0f, 0.5f);
+    sceneRotatef(rotationOffset + windmillAngle, 0, 0, 1);
 
     // Center Hub
-    glColor3f(0.3f * dim, 0.3f * dim, 0.3f * dim);
-    glutSolidSphere(1.0f, 10, 10);
+    sceneColor3f(0.3f * dim, 0.3f * dim, 0.3f * dim);
+    sceneSolidSphere(1.0f, 10, 10);
+
+    // Hub lamp
+    sceneLampColor(1.0f, 0.3f, 0.2f);
+    scenePushMatrix();
+    sceneTranslatef(0.0f, 0.0f, 1.2f);
+    sceneSolidSphere(0.3f, 8, 8);
+    scenePopMatrix();
 
-    // Blades
-    glColor3f(0.7f * dim, 0.7f * dim, 0.7f * dim);
+    // Blades, with a lamp on every tip
     for (int i = 0; i < 3; i++) {
-        glPushMatrix();
-        glRotatef(i * 120, 0, 0, 1);
-        glTranslatef(0.0f, 6.0f, 0.0f);
+        scenePushMatrix();
+        sceneRotatef(i * 120, 0, 0, 1);
+        sceneTranslatef(0.0f, 6.0f, 0.0f);
+        sceneColor3f(0.7f * dim, 0.7f * dim, 0.7f * dim);
         drawBox(0.6f, 12.0f, 0.2f);
-        glPopMatrix();
+        sceneLampColor(1.0f, 0.9f, 0.6f);
+        sceneTranslatef(0.0f, 6.0f, 0.3f);
+        sceneSolidSphere(0.3f, 8, 8);
+        scenePopMatrix();
     }
-    glPopMatrix();
-
-    glPopMatrix();
-}
-
-void drawBlock(float x, float y) {
-    glPushMatrix();
-    glTranslatef(x, y, 0.0f);
-    glutSolidCube(1.0f);
-    glPopMatrix();
-}
+    scenePopMatrix();
 
-void drawLetter(const std::vector<std::pair<int, int> >& blocks, float xOffset) {
-    glPushMatrix();
-    glTranslatef(xOffset, 0.0f, 0.0f);
-    for (size_t i = 0; i < blocks.size(); ++i) {
-        drawBlock((float)blocks[i].first, (float)blocks[i].second);
-    }
-    glPopMatrix();
+    scenePopMatrix();
 }
 
 void drawText3D() {
     // Text remains black or very dark grey
-    glColor3f(0.05f, 0.05f, 0.05f);
-
-    glPushMatrix();
-    glTranslatef(10.0f, 5.0f, 10.0f);
-    glScalef(2.5f, 2.5f, 2.5f);
-
-    std::vector<std::pair<int, int> > I, L, O, C, S;
-
-    for (int i = 0; i < 5; i++) I.push_back(std::make_pair(0, i));
-
-    L.push_back(std::make_pair(0, 0)); L.push_back(std::make_pair(1, 0)); L.push_back(std::make_pair(2, 0));
-    for (int i = 1; i < 5; i++) L.push_back(std::make_pair(0, i));
-
-    O.push_back(std::make_pair(0, 0)); O.push_back(std::make_pair(1, 0)); O.push_back(std::make_pair(2, 0));
-    O.push_back(std::make_pair(0, 4)); O.push_back(std::make_pair(1, 4)); O.push_back(std::make_pair(2, 4));
-    for (int i = 1; i < 4; i++) { O.push_back(std::make_pair(0, i)); O.push_back(std::make_pair(2, i)); }
-
-    C.push_back(std::make_pair(0, 0)); C.push_back(std::make_pair(1, 0)); C.push_back(std::make_pair(2, 0));
-    C.push_back(std::make_pair(0, 4)); C.push_back(std::make_pair(1, 4)); C.push_back(std::make_pair(2, 4));
-    for (int i = 1; i < 4; i++) C.push_back(std::make_pair(0, i));
-
-    S.push_back(std::make_pair(0, 0)); S.push_back(std::make_pair(1, 0)); S.push_back(std::make_pair(2, 0));
-    S.push_back(std::make_pair(2, 1)); S.push_back(std::make_pair(2, 2)); S.push_back(std::make_pair(1, 2));
-    S.push_back(std::make_pair(0, 2)); S.push_back(std::make_pair(0, 3)); S.push_back(std::make_pair(0, 4));
-    S.push_back(std::make_pair(1, 4)); S.push_back(std::make_pair(2, 4));
-
-    float xPos = 0.0f;
-    drawLetter(I, xPos); xPos += 2.0f;
-    drawLetter(L, xPos); xPos += 4.0f;
-    drawLetter(O, xPos); xPos += 4.0f;
-    drawLetter(C, xPos); xPos += 4.0f;
-    drawLetter(O, xPos); xPos += 4.0f;
-    drawLetter(S, xPos);
-
-    glPopMatrix();
+    sceneColor3f(0.05f, 0.05f, 0.05f);
+
+    scenePushMatrix();
+    sceneTranslatef(10.0f, 5.0f, 10.0f);
+    sceneScalef(2.5f, 2.5f, 2.5f);
+    if (selectedKind == PICK_LETTER) {
+        // Drawn in three pieces around the selected letter so it can be tinted;
+        // every piece keeps its columns, so the sign itself looks the same
+        std::string_view text = signText;
+        size_t i = selectedIndex;
+        if (i > 0) drawVoxelText(text.substr(0, i));
+        scenePushMatrix();
+        sceneTranslatef((float)signGlyphStart[i], 0.0f, 0.0f);
+        sceneHighlight = true;
+        sceneColor3f(0.05f, 0.05f, 0.05f);
+        drawVoxelText(text.substr(i, 1));
+        sceneHighlight = false;
+        sceneColor3f(0.05f, 0.05f, 0.05f);
+        scenePopMatrix();
+        if (i + 1 < text.size()) {
+            sceneTranslatef((float)signGlyphStart[i + 1], 0.0f, 0.0f);
+            drawVoxelText(text.substr(i + 1));
+        }
+    }
+    else drawVoxelText(signText);
+    scenePopMatrix();
 }
 
 // --- Interaction Functions ---
@@ -408,12 +3671,22 @@ void updateEnvironmentColor() {
 void mouseButton(int button, int state, int x, int y) {
     if (button == GLUT_LEFT_BUTTON) {
         if (state == GLUT_DOWN) {
+            applyPendingInput(); // Finish the last drag before starting from here
             isDragging = true;
             lastX = x;
             lastY = y;
+            clickX = x;
+            clickY = y;
         }
         else {
             isDragging = false;
+            applyPendingInput();
+            // A press and release in (nearly) the same spot is a click, not a drag
+            if (abs(x - clickX) + abs(y - clickY) <= 3) {
+                recordInputEvent(); // The release is what changes the selection
+                pickAt(x, y);
+                glutPostRedisplay();
+            }
         }
     }
 
@@ -422,6 +3695,7 @@ void mouseButton(int button, int state, int x, int y) {
     // Button 4 = Scroll Down (Backward in time)
     if (state == GLUT_UP) return; // Only trigger on press
 
+    recordInputEvent();
     if (button == 3) {
         timeOfDay += 5.0f;
         if (timeOfDay >= 360.0f) timeOfDay -= 360.0f;
@@ -434,87 +3708,80 @@ void mouseButton(int button, int state, int x, int y) {
     glutPostRedisplay();
 }
 
+// Only remembers where the cursor is; display() applies it once per frame
 void mouseMotion(int x, int y) {
     if (isDragging) {
-        float dx = x - lastX;
-        float dy = y - lastY;
-
-        rotY += dx * 0.5f;
-        rotX += dy * 0.5f;
-
-        lastX = x;
-        lastY = y;
-        glutPostRedisplay();
+        bool first = !motionPending;
+        motionX = x;
+        motionY = y;
+        motionPending = true;
+        recordInputEvent();
+        if (first) glutPostRedisplay();
     }
 }
 
 // --- Display & Animation ---
 
 void display() {
+    std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+    // All input since the last frame, as a single camera update
+    applyPendingInput();
+
     // Update Sky Color
     updateEnvironmentColor();
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
+    updateCamera();
 
-    glTranslatef(0.0f, -5.0f, zoom);
-    glRotatef(rotX, 1.0f, 0.0f, 0.0f);
-    glRotatef(rotY, 0.0f, 1.0f, 0.0f);
-
-    // Setup Lighting
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
-    glEnable(GL_COLOR_MATERIAL);
+    // Point lights are binned for this view before anything is shaded
+    updateSceneLights();
+    binLightClusters();
 
     // Light follows the sun logic (sort of)
     float lightIntensity = 1.0f;
     if (timeOfDay > 90 && timeOfDay < 270) lightIntensity = 0.2f; // Dim light at night
 
-    GLfloat lightPos[] = { 0.0f, 50.0f, 0.0f, 0.0f }; // Overhead light basically
-    GLfloat lightColor[] = { lightIntensity, lightIntensity, lightIntensity, 1.0f };
-
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, lightColor);
-    glLightfv(GL_LIGHT0, GL_AMBIENT, lightColor);
+    beginFrameTimer();
+    renderer->beginFrame(projectionMatrix, lightIntensity);
+    sceneLoadIdentity();
 
-    drawCelestialBodies(); // Draws Rotating Sun and Moon
+    // Big occluders go first so the occlusion queries below have depth to test against
     drawMountains();
     drawGroundAndWater();
-    drawVegetation();      // Draws new grass
 
-    // Clouds - ADDED MORE CLOUDS
-    float c1 = -40 + cloudOffset; if (c1 > 60) c1 -= 120;
-    float c2 = 10 + cloudOffset;  if (c2 > 60) c2 -= 120;
-    float c3 = -10 + cloudOffset; if (c3 > 60) c3 -= 120;
-    float c4 = -65 + cloudOffset; if (c4 > 60) c4 -= 120;
-    float c5 = 50 + cloudOffset;  if (c5 > 60) c5 -= 120;
-    float c6 = -25 + cloudOffset; if (c6 > 60) c6 -= 120;
-
-    drawCloud(c1, 35, -20, 1.2f);
-    drawCloud(c2, 38, -25, 1.0f);
-    drawCloud(c3, 32, -15, 1.5f);
-    drawCloud(c4, 36, -30, 1.3f);
-    drawCloud(c5, 40, -10, 0.9f); // New
-    drawCloud(c6, 30, -5, 1.1f);  // New
-
-    // Windmills (Original + New Ones)
-    // Left Cluster
-    drawWindmill(-55, -10, 0.9f, 20); // New Far Left
-    drawWindmill(-40, 0, 1.2f, 0);    // Original
-    drawWindmill(-25, -15, 1.0f, 45); // Original
-    drawWindmill(-10, 5, 0.8f, 90);   // Original
+    if (occlusionEnabled) rasterizeOccluders();
 
-    // Middle/Back Cluster
-    drawWindmill(-30, 10, 0.7f, 130); // New Back Middle
-    drawWindmill(-15, -20, 1.1f, 60); // New Front Middle
+    drawCelestialBodies(); // Draws Rotating Sun and Moon
+    drawVegetation();      // Draws new grass
 
+    // Windmills (Original + New Ones), see windmillLayout
+    for (int i = 0; i < NUM_WINDMILLS; i++) {
+        sceneHighlight = selectedKind == PICK_WINDMILL && selectedIndex == i;
+        drawWindmill(windmillLayout[i][0], windmillLayout[i][1], windmillLayout[i][2], windmillLayout[i][3]);
+    }
+    sceneHighlight = false;
+
+    drawBeachLamps();
     drawText3D();
 
+    // Clouds last: they are blended over everything else
+    drawClouds();
+
+    renderer->endFrame();
+
+    endFrameTimer();
+    frameStats.cpuMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    reportFrameStats();
+    resetFrameArena();
     glutSwapBuffers();
+    endLatencyFrame();
 }
 
 void timer(int value) {
     windmillAngle -= spinSpeed;
     if (windmillAngle <= -360.0f) windmillAngle += 360.0f;
+    refitWindmillBlades();
 
     cloudOffset += 0.02f;
     if (cloudOffset > 120.0f) cloudOffset = -120.0f;
@@ -529,14 +3796,16 @@ void reshape(int w, int h) {
     if (h == 0) h = 1;
     float ratio = 1.0f * w / h;
     glViewport(0, 0, w, h);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(45, ratio, 0.1, 1000);
-    glMatrixMode(GL_MODELVIEW);
+    viewportWidth = w;
+    viewportHeight = h;
+    // Renderers load this at the start of every frame
+    mat4Perspective(projectionMatrix, 45, ratio, 0.1f, 2000.0f); // Far enough for the terrain
+    resizeLightClusters(w, h);
 }
 
 // Keyboard controls for Speed (A/D) and Zoom (W/S)
 void keyboard(unsigned char key, int x, int y) {
+    recordInputEvent();
     switch (key) {
     case 'w': case 'W': // Zoom In
         zoom += 2.0f;
@@ -553,16 +3822,69 @@ void keyboard(unsigned char key, int x, int y) {
         // Keep Z/X as backups if desired, or remove them
     case 'z': case 'Z': zoom += 2.0f; break;
     case 'x': case 'X': zoom -= 2.0f; break;
+    case 'o': case 'O': // Toggle Occlusion Culling
+        occlusionEnabled = !occlusionEnabled;
+        std::cout << "Occlusion culling " << (occlusionEnabled ? "ON" : "OFF") << std::endl;
+        break;
+    case 'p': case 'P': // Toggle Frame Stats
+        printStats = !printStats;
+        break;
+    case 'l': case 'L': // Toggle Lights-per-Cluster Heatmap
+        lightClusters.heatmap = !lightClusters.heatmap;
+        break;
     }
     glutPostRedisplay();
 }
 
 int main(int argc, char** argv) {
     glutInit(&argc, argv);
+    initFrameArena(1 << 20);
+
+    // Command line: --renderer=immediate|displaylist|vbo|shader (default immediate)
+    //               --sign=TEXT (default ILOCOS)
+    //               --cloud-puffs=N (default 4096)
+    //               --pick-bench=N (time picking against N random boxes at start-up)
+    //               --extra-lights=N (default 0)
+    std::string backend = "immediate";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--renderer=", 0) == 0) backend = arg.substr(11);
+        if (arg.rfind("--sign=", 0) == 0) signText = arg.substr(7);
+        if (arg.rfind("--cloud-puffs=", 0) == 0) cloudPuffCount = std::max(1, atoi(arg.c_str() + 14));
+        if (arg.rfind("--pick-bench=", 0) == 0) pickBenchCount = std::max(0, atoi(arg.c_str() + 13));
+        if (arg.rfind("--extra-lights=", 0) == 0) extraLightCount = std::max(0, atoi(arg.c_str() + 15));
+    }
+    renderer = createRenderer(backend);
+    if (renderer == nullptr) {
+        std::cerr << "Unknown renderer '" << backend << "' (use immediate, displaylist, vbo or shader)" << std::endl;
+        return 1;
+    }
+
+    // The shader path runs on a core profile context, so nothing fixed-function can sneak in
+    if (backend == "shader") {
+        coreProfile = true;
+        glutInitContextVersion(3, 3);
+        glutInitContextProfile(GLUT_CORE_PROFILE);
+    }
+
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
     glutCreateWindow("Ilocos 3D Day/Night Cycle");
 
+    // Initialize GLEW (needed for buffers, shaders and queries)
+    glewExperimental = GL_TRUE; // Core profiles need this to load everything
+    GLenum err = glewInit();
+    if (GLEW_OK != err) {
+        std::cerr << "GLEW Error: " << glewGetErrorString(err) << std::endl;
+        return 1;
+    }
+    glGetError(); // glewInit can leave GL_INVALID_ENUM behind on core profiles
+
+    if (!renderer->init()) {
+        std::cerr << "Renderer '" << renderer->name() << "' failed to initialize" << std::endl;
+        return 1;
+    }
+
     // --- PRINT INSTRUCTIONS ---
     std::cout << "========================================" << std::endl;
     std::cout << "   Ilocos 3D Scene - Controls Guide     " << std::endl;
@@ -571,9 +3893,24 @@ int main(int argc, char** argv) {
     std::cout << " [A] / [D]        : Decrease / Increase Windmill Speed" << std::endl;
     std::cout << " Mouse Left Drag  : Rotate Scene (360 degrees)" << std::endl;
     std::cout << " Mouse Scroll     : Change Time of Day (Sunrise/Sunset/Night)" << std::endl;
+    std::cout << " Mouse Left Click : Select Tree / Windmill / Letter" << std::endl;
+    std::cout << " [O]              : Toggle Occlusion Culling" << std::endl;
+    std::cout << " [P]              : Toggle Frame Stats (console)" << std::endl;
+    std::cout << " [L]              : Toggle Lights-per-Cluster Heatmap (shader renderer)" << std::endl;
     std::cout << "========================================" << std::endl;
+    std::cout << " Renderer: " << renderer->name() << " (--renderer=immediate|displaylist|vbo|shader)" << std::endl;
 
     glEnable(GL_DEPTH_TEST);
+    initFrameTimer();
+    initLatencyTracking();
+    initGroundAndWater();
+    initTerrain();
+    initOcclusion();
+    initCloudParticles(cloudPuffCount);
+    initPicking();
+    initClusteredLighting();
+    initSceneLights(extraLightCount);
+    if (pickBenchCount > 0) runPickBenchmark(pickBenchCount);
 
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);